@@ -0,0 +1,113 @@
+#include "Context.h"
+#include <cstdint>
+
+#ifdef __x86_64__
+/* code for 64 bit Intel arch */
+
+/*
+ * Frame pushed by context_switch (from the saved sp upwards):
+ * mxcsr, x87 control word, r15, r14, r13, r12, rbx, rbp, return address.
+ * A new thread "returns" into context_trampoline with the start routine in
+ * r12 and its argument in r13.
+ */
+asm(".text\n"
+    ".globl context_switch\n"
+    ".type context_switch, @function\n"
+    "context_switch:\n"
+    "    pushq %rbp\n"
+    "    pushq %rbx\n"
+    "    pushq %r12\n"
+    "    pushq %r13\n"
+    "    pushq %r14\n"
+    "    pushq %r15\n"
+    "    subq $8, %rsp\n"
+    "    stmxcsr (%rsp)\n"
+    "    fnstcw 4(%rsp)\n"
+    "    movq %rsp, (%rdi)\n"
+    "    movq (%rsi), %rsp\n"
+    "    ldmxcsr (%rsp)\n"
+    "    fldcw 4(%rsp)\n"
+    "    addq $8, %rsp\n"
+    "    popq %r15\n"
+    "    popq %r14\n"
+    "    popq %r13\n"
+    "    popq %r12\n"
+    "    popq %rbx\n"
+    "    popq %rbp\n"
+    "    ret\n"
+    ".size context_switch, .-context_switch\n"
+    "context_trampoline:\n"
+    "    movq %r13, %rdi\n"
+    "    callq *%r12\n"
+    "    ud2\n");
+
+#define MXCSR_DEFAULT 0x1F80
+#define FPU_CW_DEFAULT 0x037F
+
+extern "C" void context_trampoline();
+
+void context_make(Context * context, char * stack, size_t size,
+                  context_start_routine start_routine, void * arg) {
+    // the trampoline is entered by ret, so the stack is 16 aligned at its call
+    auto top = (uint64_t *) (((uintptr_t) stack + size) & ~(uintptr_t) 15);
+    uint64_t * sp = top - 8;
+    sp[0] = ((uint64_t) FPU_CW_DEFAULT << 32) | MXCSR_DEFAULT;
+    sp[1] = 0;                                  // r15
+    sp[2] = 0;                                  // r14
+    sp[3] = (uint64_t) arg;                     // r13
+    sp[4] = (uint64_t) start_routine;           // r12
+    sp[5] = 0;                                  // rbx
+    sp[6] = 0;                                  // rbp, ends the frame chain
+    sp[7] = (uint64_t) context_trampoline;      // return address
+    context->sp = sp;
+}
+
+#else
+/* code for 32 bit Intel arch */
+
+/*
+ * Frame pushed by context_switch (from the saved sp upwards):
+ * edi, esi, ebx, ebp, return address.
+ * A new thread "returns" into context_trampoline with the start routine in
+ * ebx and its argument in esi.
+ */
+asm(".text\n"
+    ".globl context_switch\n"
+    ".type context_switch, @function\n"
+    "context_switch:\n"
+    "    movl 4(%esp), %eax\n"
+    "    movl 8(%esp), %edx\n"
+    "    pushl %ebp\n"
+    "    pushl %ebx\n"
+    "    pushl %esi\n"
+    "    pushl %edi\n"
+    "    movl %esp, (%eax)\n"
+    "    movl (%edx), %esp\n"
+    "    popl %edi\n"
+    "    popl %esi\n"
+    "    popl %ebx\n"
+    "    popl %ebp\n"
+    "    ret\n"
+    ".size context_switch, .-context_switch\n"
+    "context_trampoline:\n"
+    "    subl $12, %esp\n"
+    "    pushl %esi\n"
+    "    call *%ebx\n"
+    "    ud2\n");
+
+extern "C" void context_trampoline();
+
+void context_make(Context * context, char * stack, size_t size,
+                  context_start_routine start_routine, void * arg) {
+    // after ret, 12 + 4 bytes are pushed, leaving the stack 16 aligned at the call
+    auto top = (uint32_t *) (((uintptr_t) stack + size) & ~(uintptr_t) 15);
+    uint32_t * sp = top - 5;
+    sp[0] = 0;                                  // edi
+    sp[1] = (uint32_t) arg;                     // esi
+    sp[2] = (uint32_t) start_routine;           // ebx
+    sp[3] = 0;                                  // ebp, ends the frame chain
+    sp[4] = (uint32_t) context_trampoline;      // return address
+    context->sp = sp;
+}
+
+#endif
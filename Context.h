@@ -0,0 +1,33 @@
+#ifndef EX2_OS_CONTEXT_H
+#define EX2_OS_CONTEXT_H
+
+#include <cstddef>
+
+typedef void (*context_start_routine)(void *);
+
+/**
+ * Execution context of a user-level thread.
+ * Only the stack pointer is kept here: the callee-saved registers (and the
+ * floating point control words on x86-64) are pushed on the thread's own
+ * stack by context_switch, so no signal mask is saved or restored.
+ */
+struct Context {
+    void * sp;
+};
+
+extern "C" {
+/**
+ * Saves the callee-saved registers of the caller into from and resumes to.
+ * Returns in the context of from once some other thread switches back to it.
+ */
+void context_switch(Context * from, Context * to);
+}
+
+/**
+ * Prepares context so that the first switch to it calls start_routine(arg)
+ * on the stack [stack, stack + size). start_routine must never return.
+ */
+void context_make(Context * context, char * stack, size_t size,
+                  context_start_routine start_routine, void * arg);
+
+#endif //EX2_OS_CONTEXT_H
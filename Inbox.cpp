@@ -0,0 +1,46 @@
+#include "Inbox.h"
+#include "Thread.h"
+
+Inbox::Inbox() : head(&this->stub), tail(&this->stub) {
+}
+
+void Inbox::push(Thread * thread) {
+    this->push(&thread->inbox_node);
+}
+
+void Inbox::push(InboxNode * node) {
+    node->next.store(nullptr, std::memory_order_relaxed);
+    InboxNode * previous = this->head.exchange(node, std::memory_order_acq_rel);
+    previous->next.store(node, std::memory_order_release);
+}
+
+/**
+ * @return the oldest thread of the inbox, or nullptr if it is empty or the newest push is not linked yet.
+ */
+Thread * Inbox::pop() {
+    InboxNode * tail = this->tail;
+    InboxNode * next = tail->next.load(std::memory_order_acquire);
+    if (tail == &this->stub) {
+        if (next == nullptr) {
+            return nullptr;
+        }
+        this->tail = next;
+        tail = next;
+        next = next->next.load(std::memory_order_acquire);
+    }
+    if (next != nullptr) {
+        this->tail = next;
+        return tail->thread;
+    }
+    if (tail != this->head.load(std::memory_order_acquire)) {
+        return nullptr;
+    }
+    // tail is the last node: put the stub behind it so that it can be taken out
+    this->push(&this->stub);
+    next = tail->next.load(std::memory_order_acquire);
+    if (next != nullptr) {
+        this->tail = next;
+        return tail->thread;
+    }
+    return nullptr;
+}
@@ -0,0 +1,40 @@
+#ifndef EX2_OS_INBOX_H
+#define EX2_OS_INBOX_H
+
+#include <atomic>
+
+class Thread;
+
+/**
+ * Link embedded in every thread, through which it waits in an inbox.
+ */
+struct InboxNode {
+    std::atomic<InboxNode *> next{nullptr};
+    Thread * thread = nullptr;
+};
+
+/**
+ * Queue of threads handed to a worker by the other workers (Vyukov's intrusive MPSC queue).
+ * Any worker may push, with a single atomic exchange and never waiting for another worker. Pops drain the inbox
+ * into the READY queue of its worker, and are only made under the library lock: by the worker itself, or by one
+ * stealing from it or balancing the queues.
+ * The scheduler also pushes under the library lock, since a wake changes the thread's state and the sleep and
+ * release heaps with it. A wake through an inbox is therefore still serialized with every other library call:
+ * waking without the library lock is not done.
+ */
+class Inbox {
+
+private:
+    InboxNode stub;
+    std::atomic<InboxNode *> head;
+    InboxNode * tail;
+    void push(InboxNode * node);
+
+public:
+    Inbox();
+    void push(Thread * thread);
+    Thread * pop();
+};
+
+
+#endif //EX2_OS_INBOX_H
@@ -0,0 +1,247 @@
+#include "RunQueue.h"
+#include "Thread.h"
+#include "SlotTable.h"
+#include <algorithm>
+
+RunQueue::RunQueue() : fair_threads(&Thread::vruntime, &Thread::fair_index),
+                       deadline_threads(&Thread::rt_abs_deadline, &Thread::deadline_index) {
+}
+
+/**
+ * Orders the queue as the scheduling policy queue_policy does. Only called while the queue is empty.
+ */
+void RunQueue::set_policy(int queue_policy) {
+    this->policy = queue_policy;
+}
+
+/**
+ * Sets the table the tids of the queued threads are looked up in.
+ */
+void RunQueue::set_threads(const SlotTable * table) {
+    this->threads = table;
+}
+
+/**
+ * Appends thread to the level of its priority, or to the heap of an EDF queue if it has a deadline. In a fair
+ * queue, a thread whose vruntime is behind the smallest one the queue has run is brought up to it, so that a new
+ * thread, or one that slept for long, does not monopolize the worker until it catches up.
+ */
+void RunQueue::push_back(Thread * thread) {
+    thread->run_queue = this;
+    this->count.store(this->count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    if (this->policy == UTHREAD_SCHED_FAIR) {
+        if (thread->vruntime < this->min_vruntime) {
+            thread->vruntime = this->min_vruntime;
+        }
+        this->fair_threads.push(thread);
+        return;
+    }
+    if (this->policy == UTHREAD_SCHED_EDF && thread->rt_period != 0) {
+        this->deadline_threads.push(thread);
+        return;
+    }
+    int priority = thread->attr.priority;
+    thread->run_priority = priority;
+    thread->run_index = this->deques[priority].push(thread->tid);
+    if (this->level_counts[priority]++ == 0) {
+        this->levels.fetch_or(1u << priority, std::memory_order_release);
+    }
+}
+
+/**
+ * @return the first thread of the highest non-empty level (of smallest vruntime in a fair queue, of earliest deadline
+ * in an EDF queue that has a thread with one), or nullptr if the queue is empty.
+ */
+Thread * RunQueue::pop_front() {
+    if (this->policy == UTHREAD_SCHED_FAIR || !this->deadline_threads.empty()) {
+        Thread * thread = this->front();
+        this->remove(thread);
+        if (thread != nullptr && this->policy == UTHREAD_SCHED_FAIR && thread->vruntime > this->min_vruntime) {
+            this->min_vruntime = thread->vruntime;
+        }
+        return thread;
+    }
+    uint32_t remaining = this->levels.load(std::memory_order_relaxed);
+    while (remaining != 0) {
+        int level = 31 - __builtin_clz(remaining);
+        size_t tid;
+        int64_t index;
+        // stale entries are dropped on the way
+        while (this->deques[level].steal(tid, index)) {
+            Thread * thread = this->resolve(level, index, tid);
+            if (thread != nullptr) {
+                this->unlink(thread);
+                return thread;
+            }
+        }
+        remaining &= ~(1u << level);
+    }
+    return nullptr;
+}
+
+/**
+ * Removes thread from the queue. Does nothing if thread is not in this queue.
+ * A thread of a level leaves its entry behind, unless it is at the bottom of the level.
+ */
+void RunQueue::remove(Thread * thread) {
+    if (thread == nullptr || thread->run_queue != this) {
+        return;
+    }
+    if (this->policy == UTHREAD_SCHED_FAIR) {
+        this->fair_threads.remove(thread);
+    } else if (this->deadline_threads.contains(thread)) {
+        this->deadline_threads.remove(thread);
+    }
+    this->unlink(thread);
+}
+
+/**
+ * Takes the oldest entry of the highest level that has a live thread, dropping the entries of removed threads on
+ * the way. May be called by any worker, without the lock: the entry is only a claim on the thread, which is checked
+ * by claim once the lock is held.
+ * @return whether an entry was taken, which may still turn out to be stale.
+ */
+bool RunQueue::steal(StolenThread & stolen) {
+    if (this->policy == UTHREAD_SCHED_FAIR) {
+        return false;
+    }
+    uint32_t remaining = this->levels.load(std::memory_order_acquire);
+    while (remaining != 0) {
+        int level = 31 - __builtin_clz(remaining);
+        while (this->deques[level].steal(stolen.tid, stolen.index)) {
+            if (stolen.tid != REMOVED_ENTRY) {
+                stolen.queue = this;
+                stolen.level = level;
+                return true;
+            }
+        }
+        remaining &= ~(1u << level);
+    }
+    return false;
+}
+
+/**
+ * Removes the thread of an entry stolen from the queue. Only called under the library lock.
+ * @return the thread, or nullptr if the entry was stale: the thread was removed, moved or terminated meanwhile.
+ */
+Thread * RunQueue::claim(const StolenThread & stolen) {
+    Thread * thread = this->resolve(stolen.level, stolen.index, stolen.tid);
+    if (thread != nullptr) {
+        this->unlink(thread);
+    }
+    return thread;
+}
+
+/**
+ * @return the thread of the entry at index of level, or nullptr if the entry is stale.
+ */
+Thread * RunQueue::resolve(int level, int64_t index, size_t tid) const {
+    if (!this->threads->contains(tid)) {
+        return nullptr;
+    }
+    Thread * thread = this->threads->get(tid);
+    if (thread->run_queue != this || thread->run_priority != level || thread->run_index != index) {
+        return nullptr;
+    }
+    return thread;
+}
+
+/**
+ * Marks thread as out of the queue, which makes its entry stale if it has one.
+ */
+void RunQueue::unlink(Thread * thread) {
+    thread->run_queue = nullptr;
+    this->count.store(this->count.load(std::memory_order_relaxed) - 1, std::memory_order_relaxed);
+    if (thread->run_index < 0) {
+        return;
+    }
+    int level = thread->run_priority;
+    this->deques[level].replace(thread->run_index, REMOVED_ENTRY);
+    thread->run_index = NOT_IN_RUN_QUEUE;
+    if (--this->level_counts[level] == 0) {
+        this->levels.fetch_and(~(1u << level), std::memory_order_relaxed);
+    }
+    this->trim(level);
+}
+
+/**
+ * Pops the stale entries at the bottom of level, so that a thread removed and pushed back again does not grow it.
+ */
+void RunQueue::trim(int level) {
+    WorkDeque & deque = this->deques[level];
+    size_t tid;
+    int64_t last = deque.get_bottom() - 1;
+    while (deque.at(last, tid) && this->resolve(level, last, tid) == nullptr && deque.pop(tid)) {
+        last--;
+    }
+}
+
+Thread * RunQueue::front() const {
+    if (this->policy == UTHREAD_SCHED_FAIR) {
+        return this->fair_threads.top();
+    }
+    if (!this->deadline_threads.empty()) {
+        return this->deadline_threads.top();
+    }
+    return this->first_from(this->top_priority(), INT64_MIN);
+}
+
+/**
+ * @return the thread after thread in the order threads are popped: the next one of its level, or else the first
+ * one of the next lower non-empty level. nullptr after the last thread. The heaps of fair and EDF queues are walked
+ * in heap order.
+ */
+Thread * RunQueue::next(const Thread * thread) const {
+    if (this->policy == UTHREAD_SCHED_FAIR) {
+        return this->fair_threads.at(thread->fair_index + 1);
+    }
+    if (this->deadline_threads.contains(thread)) {
+        Thread * next = this->deadline_threads.at(thread->deadline_index + 1);
+        if (next != nullptr) {
+            return next;
+        }
+        return this->first_from(this->top_priority(), INT64_MIN);
+    }
+    return this->first_from(thread->run_priority, thread->run_index + 1);
+}
+
+/**
+ * @return the first live thread at or after index in level, or else the first one of the next lower non-empty
+ * level, or nullptr if there is none.
+ */
+Thread * RunQueue::first_from(int level, int64_t index) const {
+    uint32_t remaining = level < 0 ? 0 : this->levels.load(std::memory_order_relaxed) & ((2u << level) - 1);
+    while (remaining != 0) {
+        level = 31 - __builtin_clz(remaining);
+        const WorkDeque & deque = this->deques[level];
+        size_t tid;
+        for (index = std::max(index, deque.get_top()); deque.at(index, tid); index++) {
+            Thread * thread = this->resolve(level, index, tid);
+            if (thread != nullptr) {
+                return thread;
+            }
+        }
+        remaining &= ~(1u << level);
+        index = INT64_MIN;
+    }
+    return nullptr;
+}
+
+/**
+ * @return the highest priority that has a thread in the queue, or -1 if the queue is empty or fair.
+ */
+int RunQueue::top_priority() const {
+    if (this->policy == UTHREAD_SCHED_FAIR) {
+        return -1;
+    }
+    uint32_t nonempty = this->levels.load(std::memory_order_relaxed);
+    return nonempty == 0 ? -1 : 31 - __builtin_clz(nonempty);
+}
+
+bool RunQueue::empty() const {
+    return this->size() == 0;
+}
+
+size_t RunQueue::size() const {
+    return this->count.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,79 @@
+#ifndef EX2_OS_RUNQUEUE_H
+#define EX2_OS_RUNQUEUE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include "uthreads.h"
+#include "ThreadHeap.h"
+#include "WorkDeque.h"
+#define NOT_IN_RUN_QUEUE (-1) /* run index of a thread without an entry in a level of a run queue */
+#define REMOVED_ENTRY SIZE_MAX /* tid left in the entry of a removed thread, which thieves skip */
+
+class Thread;
+class SlotTable;
+class RunQueue;
+
+/**
+ * Entry taken from a run queue without the library lock: the queue, the level and index it had there, and the
+ * tid of its thread, which only the lock holder may look up.
+ */
+struct StolenThread {
+    RunQueue * queue = nullptr;
+    int level = 0;
+    int64_t index = 0;
+    size_t tid = 0;
+};
+
+/**
+ * One work-stealing deque of tids per priority level, popped from the top, so every level is a FIFO.
+ * A thread is in at most one queue at a time, recorded in its run_queue field, at the level in its run_priority
+ * and the index in its run_index. Removing a thread only clears those fields and overwrites its tid, leaving its
+ * entry behind, which is skipped once it reaches the top, like a terminated thread is when its inbox is drained;
+ * the stale entries at the bottom are popped right away. An entry is live only while the thread of its tid still
+ * has that queue, level and index, so an entry a thief read just before it was overwritten never matches a later
+ * push of the same thread or of a new one with its tid.
+ * A bitmap of the levels with a live thread lets the highest priority thread be found with a single bit scan.
+ * A fair queue instead keeps its threads in a min-heap on their vruntime, so the thread charged least comes first.
+ * An EDF queue keeps its threads with a deadline in a min-heap on it, ahead of the levels of the other threads.
+ * The queue is only changed under the library lock, but other workers may steal the top of its levels without it,
+ * and claim what they took once they hold the lock; the heaps can only be stolen from under the lock. Until then
+ * a stolen thread is still counted in the queue, but can no longer be popped from it. Its size may be read
+ * without the lock, as a hint.
+ */
+class RunQueue {
+
+private:
+    static_assert(PRIORITY_LEVELS <= 32, "one bit per priority level");
+    WorkDeque deques[PRIORITY_LEVELS];
+    size_t level_counts[PRIORITY_LEVELS] = {};
+    std::atomic<uint32_t> levels{0};
+    const SlotTable * threads = nullptr;
+    int policy = UTHREAD_SCHED_PRIORITY;
+    ThreadHeap fair_threads;
+    ThreadHeap deadline_threads;
+    uint64_t min_vruntime = 0;
+    std::atomic<size_t> count{0};
+    Thread * resolve(int level, int64_t index, size_t tid) const;
+    Thread * first_from(int level, int64_t index) const;
+    void unlink(Thread * thread);
+    void trim(int level);
+
+public:
+    RunQueue();
+    void set_policy(int queue_policy);
+    void set_threads(const SlotTable * table);
+    void push_back(Thread * thread);
+    Thread * pop_front();
+    void remove(Thread * thread);
+    bool steal(StolenThread & stolen);
+    Thread * claim(const StolenThread & stolen);
+    Thread * front() const;
+    Thread * next(const Thread * thread) const;
+    int top_priority() const;
+    bool empty() const;
+    size_t size() const;
+};
+
+
+#endif //EX2_OS_RUNQUEUE_H
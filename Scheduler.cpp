@@ -6,88 +6,1031 @@
 
 #include "Scheduler.h"
 
+/*
+ * Weight of each priority under the FAIR policy: Linux's weights for nice values 16 down to -15, each level
+ * getting 25% more CPU than the one below it. DEFAULT_PRIORITY weighs FAIR_DEFAULT_WEIGHT.
+ */
+static const uint64_t FAIR_WEIGHTS[PRIORITY_LEVELS] = {
+        29, 36, 45, 56, 70, 87, 110, 137, 172, 215, 272, 335, 423, 526, 655, 820,
+        1024, 1277, 1586, 1991, 2501, 3121, 3906, 4904, 6100, 7620, 9548, 11916, 14949, 18705, 23254, 29154
+};
+#define FAIR_DEFAULT_WEIGHT 1024
+
 void Scheduler::change_thread(int signal) {
 
-    // Block all signals contained in set.
-    this->block_signals();
-    if (setitimer(ITIMER_VIRTUAL, &this->timer, nullptr) == FAILURE_ERROR)
-    {
-        handleErrorSystemCall((char  *) "TIMER ERROR");
+    // The library is in the middle of an operation, so the switch waits until it leaves it.
+    if (Worker::in_library()) {
+        Worker::set_preemption_pending(true);
+        return;
     }
-    if (save_current_execution_context() == 1) {
+    Worker::enter_library();
+    this->lock.lock();
+    if (this->deschedule_stopped_thread()) {
+        // blocked by another worker, the thread was switched out just now: being resumed was its next dispatch
+        this->unblock_signals();
         return;
     }
+    Worker::set_preemption_pending(false);
+    Worker & worker = Worker::current();
+    // a gang's slice ends together: the member whose own timer expired first preempts the others
+    if (!worker.gang_kicked && worker.running_thread->gang != 0) {
+        this->deschedule_gang(*worker.running_thread);
+    }
+    worker.gang_kicked = false;
+    if (this->policy == UTHREAD_SCHED_MLFQ && !worker.kicked && worker.running_thread->attr.priority > 0) {
+        // the thread used up its whole quantum, so it is CPU bound for now
+        --worker.running_thread->attr.priority;
+        ++this->demotions;
+    }
+    worker.kicked = false;
+    if (worker.ran_next && worker.run_next != nullptr) {
+        // the running thread was itself handed the CPU, so a further handoff waits its turn instead of letting
+        // two threads that resume each other keep the worker from its queue
+        Thread * next = worker.run_next;
+        worker.run_next = nullptr;
+        this->push_ready_thread(*next);
+    }
     _handle_sleep_threads();
+    this->release_jobs();
+    this->balance_if_due();
+    this->boost_if_due();
     // ready <-> running
-    ready_thread(this->running_thread_tid);
+    ready_thread(this->get_running_thread_tid());
     this->run_next_thread();
 
-    // Unblock all signals contained in set.
     this->unblock_signals();
 }
 
 void Scheduler::ready_thread(size_t tid) {
+    if (this->charging && &this->get_thread(tid) == Worker::current().running_thread) {
+        // charged before it is queued: its vruntime is its key there, and its budget decides whether it is
+        this->charge_running_thread(Worker::current());
+    }
     this->get_thread(tid).state = READY;
-    if(this->sleeping_threads.find(tid) == this->sleeping_threads.end()) {
-        ready_threads.push_back(tid);
+    if (this->hold_back(this->get_thread(tid))) {
+        return;
     }
+    this->push_ready_thread(this->get_thread(tid));
 }
 
 /**
- *
- * @return 1 in case is called by sigsetjmp else 0;
-*/
-int Scheduler::save_current_execution_context() {
-    if(sigsetjmp(this->get_thread(this->running_thread_tid).env, 1) == 1) {
-        this->unblock_signals();
-        return 1;
+ * @return whether a READY thread must not be queued yet: it sleeps, waits for the release of its next job, or has
+ * used up the budget of its job under the EDF policy, in which case it is throttled until its next release.
+ */
+bool Scheduler::hold_back(Thread & thread) {
+    if (this->sleeping_threads.contains(&thread) || this->releases.contains(&thread)) {
+        return true;
     }
-    return 0;
+    if (this->policy == UTHREAD_SCHED_EDF && thread.rt_period != 0 && thread.rt_remaining <= 0) {
+        this->throttle_thread(thread);
+        return true;
+    }
+    return false;
 }
-void Scheduler::_handle_sleep_threads() {
-    size_t tid;
-    size_t num_quantums;
-    std::deque<size_t> awake_threads;
-    for (auto sleep_thread: this->sleeping_threads) {
-        tid = sleep_thread.first;
-        num_quantums = sleep_thread.second;
-        Thread & thread = get_thread(tid);
-        if ((int) num_quantums - 1 <= total_quantums) {
-            awake_threads.push_back(tid);
-            if (thread.state == READY) {
-                ready_threads.push_back(tid);
+
+/**
+ * Queues a READY thread on the worker it last ran on, or on the least loaded worker its affinity allows if that
+ * one is not. Another worker's queue is never touched: the thread goes to that worker's inbox instead, still
+ * under the library lock like the rest of the wake.
+ * An idle worker that should run the thread is woken: the owner of the queue or inbox, or else the nearest idle
+ * worker that may steal it.
+ */
+void Scheduler::push_ready_thread(Thread & thread) {
+    if (thread.boost_epoch != this->boost_epoch) {
+        this->restore_priority(thread);
+    }
+    Worker * worker = thread.home;
+    if ((thread.attr.worker_mask & worker->mask()) == 0) {
+        worker = nullptr;
+        for (Worker * allowed : this->workers) {
+            if ((thread.attr.worker_mask & allowed->mask()) != 0 &&
+                (worker == nullptr || allowed->ready_threads.size() < worker->ready_threads.size())) {
+                worker = allowed;
+            }
+        }
+    }
+    if (worker == &Worker::current()) {
+        worker->ready_threads.push_back(&thread);
+    } else {
+        thread.in_inbox = true;
+        worker->inbox.push(&thread);
+        if (worker->idle) {
+            this->wake_worker(*worker);
+            return;
+        }
+    }
+    this->preempt_for(*worker, thread);
+    for (std::vector<Worker *> & victims : worker->victims) {
+        for (Worker * thief : victims) {
+            if (thief->idle && (thread.attr.worker_mask & thief->mask()) != 0) {
+                this->wake_worker(*thief);
+                return;
+            }
+        }
+    }
+}
+
+/**
+ * @return whether thread should run before other, so that it preempts it: under the EDF policy if it has the
+ * earlier deadline (any deadline being earlier than none), else if it has the higher priority. Never under the
+ * FAIR policy, where the timer alone shares the CPU.
+ */
+bool Scheduler::runs_before(const Thread & thread, const Thread & other) const {
+    if (this->policy == UTHREAD_SCHED_FAIR) {
+        return false;
+    }
+    if (this->policy == UTHREAD_SCHED_EDF && (thread.rt_period != 0 || other.rt_period != 0)) {
+        return thread.rt_period != 0 && (other.rt_period == 0 || thread.rt_abs_deadline < other.rt_abs_deadline);
+    }
+    return thread.attr.priority > other.attr.priority;
+}
+
+/**
+ * @return whether the queued thread should be picked before the handed off thread other: as runs_before has it,
+ * or under the FAIR policy if it was charged less.
+ */
+bool Scheduler::runs_ahead(const Thread & thread, const Thread & other) const {
+    if (this->policy == UTHREAD_SCHED_FAIR) {
+        return thread.vruntime < other.vruntime;
+    }
+    return this->runs_before(thread, other);
+}
+
+/**
+ * Preempts the thread running on worker if thread should run before it: at once if that is another worker, or
+ * when the library is left if it is the current one.
+ */
+void Scheduler::preempt_for(Worker & worker, const Thread & thread) {
+    if (worker.running_thread == nullptr || !this->runs_before(thread, *worker.running_thread)) {
+        return;
+    }
+    if (&worker == &Worker::current()) {
+        worker.kicked = true;
+        Worker::set_preemption_pending(true);
+    } else {
+        this->kick(worker);
+    }
+}
+
+/**
+ * Tells an idle worker that it may find a thread to run, waking it if it is parked.
+ * The worker is no longer idle until it looked for one, so the next thread queued wakes another worker.
+ */
+void Scheduler::wake_worker(Worker & worker) {
+    worker.idle = false;
+    worker.wakeups.fetch_add(1, std::memory_order_seq_cst);
+    if (worker.parked.load(std::memory_order_seq_cst)) {
+        syscall(SYS_futex, &worker.wakeups, FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+    }
+}
+
+/**
+ * Waits without the lock until the worker is woken: spins for idle_spin_usecs first, since work often comes back
+ * soon, then parks the kernel thread on a futex so that an idle worker takes no CPU at all.
+ * Meanwhile, and once more when it is woken, the worker steals from the run queues of victims, nearest first,
+ * without taking the lock.
+ * @return whether an entry was stolen into stolen, which is only claimed once the lock is held again.
+ */
+bool Scheduler::wait_for_work(Worker & worker, uint32_t wakeups, uint64_t until_nsecs,
+                              const std::vector<RunQueue *> & victims, StolenThread & stolen) {
+    struct timespec start{}, now{};
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while (true) {
+        if (this->steal_without_lock(victims, stolen)) {
+            return true;
+        }
+        if (worker.wakeups.load(std::memory_order_acquire) != wakeups) {
+            return false;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        uint64_t now_nsecs = (uint64_t) now.tv_sec * 1000000000ULL + now.tv_nsec;
+        if (now_nsecs >= until_nsecs) {
+            return false;
+        }
+        long spun_usecs = (now.tv_sec - start.tv_sec) * SECOND + (now.tv_nsec - start.tv_nsec) / 1000;
+        if (spun_usecs < this->idle_spin_usecs) {
+            CPU_RELAX();
+            continue;
+        }
+        worker.parked.store(true, std::memory_order_seq_cst);
+        if (worker.wakeups.load(std::memory_order_seq_cst) == wakeups) {
+            worker.parks.fetch_add(1, std::memory_order_relaxed);
+            struct timespec timeout{};
+            if (until_nsecs != UINT64_MAX) {
+                timeout.tv_sec = (time_t) ((until_nsecs - now_nsecs) / 1000000000ULL);
+                timeout.tv_nsec = (long) ((until_nsecs - now_nsecs) % 1000000000ULL);
             }
+            syscall(SYS_futex, &worker.wakeups, FUTEX_WAIT_PRIVATE, wakeups,
+                    until_nsecs == UINT64_MAX ? nullptr : &timeout, nullptr, 0);
+        }
+        worker.parked.store(false, std::memory_order_relaxed);
+    }
+}
+
+/**
+ * Steals an entry from the first of the run queues of victims that has one, without taking the lock.
+ * @return whether an entry was stolen into stolen, which is only claimed once the lock is held.
+ */
+bool Scheduler::steal_without_lock(const std::vector<RunQueue *> & victims, StolenThread & stolen) const {
+    for (RunQueue * victim : victims) {
+        if (victim->steal(stolen)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Wakes the sleeping threads that are due by the quantum about to start.
+ * Sleepers are kept in a heap ordered by wake quantum, so only the threads that wake up are touched.
+ */
+void Scheduler::_handle_sleep_threads() {
+    while (!this->sleeping_threads.empty() &&
+           this->sleeping_threads.top()->wake_quantum <= (uint64_t) total_quantums + 1) {
+        Thread * thread = this->sleeping_threads.pop();
+        if (thread->state == READY) {
+            this->push_ready_thread(*thread);
+        }
+    }
+}
+
+/**
+ * Starts a new quantum of thread on the current worker's timer: its own time slice if it has one, else the quantum
+ * the library was initialized with. Under the EDF policy the first expiry comes no later than the end of the budget
+ * of the thread's job, or than the next job release, so that both are acted on in time.
+ */
+void Scheduler::reset_time(const Thread & thread) {
+    struct itimerspec slice = this->timer;
+    if (thread.attr.time_slice_usecs != 0) {
+        slice.it_value.tv_sec = thread.attr.time_slice_usecs / SECOND;
+        slice.it_value.tv_nsec = thread.attr.time_slice_usecs % SECOND * 1000;
+        slice.it_interval = slice.it_value;
+    }
+    if (this->policy == UTHREAD_SCHED_EDF) {
+        uint64_t slice_nsecs = slice.it_value.tv_sec * 1000000000ULL + slice.it_value.tv_nsec;
+        if (thread.rt_period != 0) {
+            slice_nsecs = std::min(slice_nsecs, (uint64_t) std::max(thread.rt_remaining, (int64_t) 0));
+        }
+        if (!this->releases.empty()) {
+            uint64_t now = this->now_nsecs();
+            uint64_t release = this->releases.top()->rt_release;
+            slice_nsecs = std::min(slice_nsecs, release > now ? release - now : 1000);
         }
+        slice_nsecs = std::max(slice_nsecs, (uint64_t) 1000);
+        slice.it_value.tv_sec = (time_t) (slice_nsecs / 1000000000ULL);
+        slice.it_value.tv_nsec = (long) (slice_nsecs % 1000000000ULL);
     }
-    for (auto & awake_thread : awake_threads) {
-        this->sleeping_threads.erase(awake_thread);
+    if (timer_settime(Worker::current().timer, 0, &slice, nullptr) == FAILURE_ERROR)
+    {
+        handleErrorSystemCall((char  *) "TIMER ERROR");
+    }
+}
+
+/**
+ * Stops the current worker's timer, so that an idle worker is not interrupted.
+ */
+void Scheduler::stop_time() {
+    struct itimerspec stopped{};
+    if (timer_settime(Worker::current().timer, 0, &stopped, nullptr) == FAILURE_ERROR)
+    {
+        handleErrorSystemCall((char  *) "TIMER ERROR");
     }
 }
 
-void Scheduler::reset_time() {
-    if (setitimer(ITIMER_VIRTUAL, &this->timer, nullptr) == FAILURE_ERROR)
+/**
+ * Creates the timer of the worker running on the calling kernel thread. It counts the CPU time of that kernel
+ * thread only, and sends SIGVTALRM to it, so every worker's quantum expires on its own.
+ */
+void Scheduler::create_timer(Worker & worker) {
+    struct sigevent event{};
+    event.sigev_notify = SIGEV_THREAD_ID;
+    event.sigev_signo = SIGVTALRM;
+    event.sigev_notify_thread_id = (pid_t) syscall(SYS_gettid);
+    if (timer_create(CLOCK_THREAD_CPUTIME_ID, &event, &worker.timer) == FAILURE_ERROR)
+    {
+        handleErrorSystemCall((char  *) "TIMER ERROR");
+    }
+    // the same clock, readable by the other workers, tells the balancer how busy the worker was
+    if (pthread_getcpuclockid(pthread_self(), &worker.cpu_clock) != 0)
     {
         handleErrorSystemCall((char  *) "TIMER ERROR");
     }
 }
 
+/**
+ * Saves the context of the running thread and resumes the thread at the front of the ready list.
+ * Returns once the saved thread is scheduled again (never, if it was terminated), possibly on another worker.
+ */
 void Scheduler::run_next_thread () {
+    Worker & worker = Worker::current();
+    this->run_thread(worker, this->pick_next_thread(worker));
+}
 
-    ++this->total_quantums;
-    this->running_thread_tid = this->ready_threads.front();
-    this->ready_threads.pop_front();
-    Thread & new_thread = this->get_thread(this->running_thread_tid);
-    new_thread.state = RUNNNING;
-    ++new_thread.quantum_t;
-    siglongjmp(new_thread.env, 1);
+/**
+ * Switches the worker from its running thread to new_thread, or to its idle context if new_thread is nullptr.
+ */
+void Scheduler::run_thread(Worker & worker, Thread * new_thread) {
+    Thread * previous_thread = worker.running_thread;
+    if (this->charging) {
+        this->charge_running_thread(worker);
+    }
+    previous_thread->worker = nullptr;
+    this->switch_to(worker, &previous_thread->context, new_thread);
 }
 
+/**
+ * @return the thread at the front of the worker's ready list, or a thread stolen from another worker if it is
+ * empty and steal is set, or nullptr if the worker may run no READY thread. The thread in the run next slot goes first, unless a
+ * queued thread should run before it: it then waits in the queue like any other.
+ */
+Thread * Scheduler::pick_next_thread(Worker & worker, bool steal) {
+    if (worker.gang_thread != nullptr) {
+        Thread * thread = worker.gang_thread;
+        worker.gang_thread = nullptr;
+        return thread;
+    }
+    this->drain_inbox(worker);
+    worker.ran_next = false;
+    if (worker.run_next != nullptr) {
+        Thread * thread = worker.run_next;
+        worker.run_next = nullptr;
+        Thread * front = worker.ready_threads.front();
+        if (front == nullptr || !this->runs_ahead(*front, *thread)) {
+            worker.ran_next = true;
+            ++worker.handoffs;
+            return thread;
+        }
+        worker.ready_threads.push_back(thread);
+    }
+    Thread * thread = worker.ready_threads.pop_front();
+    if (thread == nullptr && steal) {
+        thread = this->steal_thread(worker);
+    }
+    return thread;
+}
 
+/**
+ * Switches the worker from the context in from to new_thread, or to its idle context if new_thread is nullptr.
+ * The library lock is handed over to the resumed context.
+ */
+void Scheduler::switch_to(Worker & worker, Context * from, Thread * new_thread) {
+    if (new_thread == nullptr) {
+        worker.running_thread = nullptr;
+        context_switch(from, &worker.idle_context);
+    } else {
+        if (new_thread->gang != 0) {
+            this->coschedule_gang(*new_thread, worker);
+        }
+        ++this->total_quantums;
+        new_thread->state = RUNNNING;
+        ++new_thread->quantum_t;
+        new_thread->worker = &worker;
+        new_thread->home = &worker;
+        worker.running_thread = new_thread;
+        this->reset_time(*new_thread);
+        // whatever preemption was due is this switch
+        Worker::set_preemption_pending(false);
+        context_switch(from, &new_thread->context);
+    }
+    this->release_terminated_thread();
+}
+
+/**
+ * Runs the READY members of the gang of thread, which is about to run on worker, on other workers at the same
+ * time: each is put in the gang slot of a worker not running a member yet, which is preempted (or woken) to run it.
+ * Members that find no such worker wait in their queues as usual.
+ */
+void Scheduler::coschedule_gang(Thread & thread, Worker & worker) {
+    for (Thread * member : this->gangs[thread.gang]) {
+        if (member == &thread || member->state != READY || member->run_queue == nullptr) {
+            continue;
+        }
+        Worker * target = nullptr;
+        for (Worker * other : this->workers) {
+            if (other == &worker || other->gang_thread != nullptr || (member->attr.worker_mask & other->mask()) == 0 ||
+                (other->running_thread != nullptr && other->running_thread->gang == thread.gang)) {
+                continue;
+            }
+            if (target == nullptr || other == member->home) {
+                target = other;
+            }
+        }
+        if (target == nullptr) {
+            continue;
+        }
+        member->run_queue->remove(member);
+        target->gang_thread = member;
+        ++this->gang_coschedules;
+        if (target->running_thread != nullptr) {
+            target->gang_kicked = true;
+            this->kick(*target);
+        } else if (target->idle) {
+            this->wake_worker(*target);
+        }
+    }
+}
+
+/**
+ * Preempts the members of the gang of thread running on other workers, so that the whole gang leaves the CPUs
+ * together and is dispatched together again.
+ */
+void Scheduler::deschedule_gang(Thread & thread) {
+    for (Thread * member : this->gangs[thread.gang]) {
+        if (member != &thread && member->state == RUNNNING && member->worker != nullptr &&
+            member->worker != thread.worker) {
+            member->worker->gang_kicked = true;
+            this->kick(*member->worker);
+        }
+    }
+}
+
+/**
+ * Sets the priority of the thread with ID tid, moving it to the level of its new priority if it is queued, and
+ * preempting whichever thread should now give way to it (or to the queue it leaves behind, if it is running).
+ */
+void Scheduler::set_thread_priority(size_t tid, int priority) {
+    Thread & thread = this->get_thread(tid);
+    thread.attr.priority = priority;
+    thread.base_priority = priority;
+    if (thread.run_queue != nullptr) {
+        RunQueue * queue = thread.run_queue;
+        queue->remove(&thread);
+        queue->push_back(&thread);
+        for (Worker * worker : this->workers) {
+            if (queue == &worker->ready_threads) {
+                this->preempt_for(*worker, thread);
+            }
+        }
+    } else if (thread.state == RUNNNING && thread.worker != nullptr &&
+               thread.worker->ready_threads.front() != nullptr) {
+        this->preempt_for(*thread.worker, *thread.worker->ready_threads.front());
+    }
+}
+
+/**
+ * Moves the thread with ID tid to gang, or out of any gang if gang is 0.
+ */
+void Scheduler::set_thread_gang(size_t tid, int gang) {
+    Thread & thread = this->get_thread(tid);
+    if (thread.gang == gang) {
+        return;
+    }
+    this->leave_gang(thread);
+    thread.gang = gang;
+    if (gang != 0) {
+        this->gangs[gang].push_back(&thread);
+    }
+}
+
+size_t Scheduler::get_gang_size(int gang) const {
+    auto members = this->gangs.find(gang);
+    return members == this->gangs.end() ? 0 : members->second.size();
+}
+
+void Scheduler::leave_gang(Thread & thread) {
+    if (thread.gang == 0) {
+        return;
+    }
+    std::vector<Thread *> & members = this->gangs[thread.gang];
+    members.erase(std::find(members.begin(), members.end(), &thread));
+    if (members.empty()) {
+        this->gangs.erase(thread.gang);
+    }
+    thread.gang = 0;
+}
+
+/**
+ * Takes a READY thread out of the queue or slot it waits in, if any.
+ */
+void Scheduler::unqueue_thread(Thread & thread) {
+    if (thread.run_queue != nullptr) {
+        thread.run_queue->remove(&thread);
+    }
+    for (Worker * worker : this->workers) {
+        if (worker->gang_thread == &thread) {
+            worker->gang_thread = nullptr;
+        }
+        if (worker->run_next == &thread) {
+            worker->run_next = nullptr;
+        }
+    }
+}
 
-Scheduler::Scheduler(int quantum_usecs, void (* callback_handler)(int)){
+/**
+ * Readies a thread resumed by the running thread in the run next slot of the current worker, so that it runs as
+ * soon as the running thread leaves the CPU, on the same core while the data they share is still in its caches.
+ * The running thread leaves it at once if the resumed thread should run before it.
+ * The thread the slot held before goes to the back of its queue.
+ */
+void Scheduler::hand_off_thread(Thread & thread) {
+    Worker & worker = Worker::current();
+    thread.state = READY;
+    if (this->hold_back(thread)) {
+        return;
+    }
+    if (thread.boost_epoch != this->boost_epoch) {
+        this->restore_priority(thread);
+    }
+    if ((thread.attr.worker_mask & worker.mask()) == 0) {
+        this->push_ready_thread(thread);
+        return;
+    }
+    Thread * previous = worker.run_next;
+    worker.run_next = &thread;
+    if (previous != nullptr) {
+        this->push_ready_thread(*previous);
+    }
+    this->preempt_for(worker, thread);
+}
+
+/**
+ * Runs a balancing pass once balance_interval quanta went by since the last one.
+ */
+void Scheduler::balance_if_due() {
+    if (this->balance_interval == 0 || this->workers.size() == 1 ||
+        this->total_quantums < this->next_balance_quantum) {
+        return;
+    }
+    this->next_balance_quantum = this->total_quantums + this->balance_interval;
+    this->balance();
+}
+
+void Scheduler::boost_if_due() {
+    if (this->policy != UTHREAD_SCHED_MLFQ || this->boost_interval == 0 ||
+        this->total_quantums < this->next_boost_quantum) {
+        return;
+    }
+    this->next_boost_quantum = this->total_quantums + this->boost_interval;
+    this->boost();
+}
+
+/**
+ * Raises every thread back to the priority it was given, so that threads the MLFQ policy lowered for using up
+ * their quantums are not starved by the threads that stayed above them. Only the queued and running threads are
+ * raised here: the others are raised once they become READY, by their boost_epoch being behind.
+ */
+void Scheduler::boost() {
+    ++this->boost_epoch;
+    ++this->boosts;
+    std::vector<Thread *> queued;
+    for (Worker * worker : this->workers) {
+        queued.clear();
+        for (Thread * thread = worker->ready_threads.front(); thread != nullptr;
+             thread = worker->ready_threads.next(thread)) {
+            queued.push_back(thread);
+        }
+        for (Thread * thread : queued) {
+            worker->ready_threads.remove(thread);
+            this->restore_priority(*thread);
+            worker->ready_threads.push_back(thread);
+        }
+        if (worker->running_thread != nullptr) {
+            this->restore_priority(*worker->running_thread);
+        }
+    }
+}
+
+/**
+ * Charges the thread running on worker, the current one, with the CPU time the worker used since the last charge:
+ * under the FAIR policy, scaled by FAIR_DEFAULT_WEIGHT over the thread's weight, and under the EDF policy, against
+ * the budget of its current job. A thread already queued is not charged again, since that could change its key in
+ * the queue: the little time since it was queued is charged to no thread.
+ */
+void Scheduler::charge_running_thread(Worker & worker) {
+    struct timespec now{};
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    uint64_t nsecs = (uint64_t) now.tv_sec * 1000000000ULL + now.tv_nsec;
+    Thread * thread = worker.running_thread;
+    if (thread != nullptr && thread->run_queue == nullptr) {
+        if (this->policy == UTHREAD_SCHED_FAIR) {
+            uint64_t weight = FAIR_WEIGHTS[thread->attr.priority];
+            thread->vruntime += (nsecs - worker.charged_nsecs) * FAIR_DEFAULT_WEIGHT / weight;
+        } else if (thread->rt_period != 0) {
+            thread->rt_remaining -= (int64_t) (nsecs - worker.charged_nsecs);
+        }
+    }
+    worker.charged_nsecs = nsecs;
+}
+
+uint64_t Scheduler::now_nsecs() {
+    struct timespec now{};
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+/**
+ * Starts the job of a thread with a deadline released at release: its deadline is rt_deadline later, and its budget
+ * is full again.
+ */
+void Scheduler::start_job(Thread & thread, uint64_t release) {
+    thread.rt_release = release;
+    thread.rt_abs_deadline = release + thread.rt_deadline;
+    thread.rt_remaining = (int64_t) thread.rt_budget;
+}
+
+/**
+ * Holds back a thread that used up the budget of its job until its next job is released, so that a thread that
+ * overruns cannot take the CPU time other threads with deadlines were admitted with.
+ */
+void Scheduler::throttle_thread(Thread & thread) {
+    thread.rt_throttled = true;
+    thread.rt_release += thread.rt_period;
+    this->releases.push(&thread);
+}
+
+/**
+ * Releases the jobs due by now: threads with a deadline that waited for their next period, or were throttled,
+ * become READY again (unless they are blocked or sleeping) with a new deadline and a full budget.
+ * A throttled thread had not finished its job, which counts as a deadline miss.
+ */
+void Scheduler::release_jobs() {
+    if (this->releases.empty()) {
+        return;
+    }
+    uint64_t now = this->now_nsecs();
+    while (!this->releases.empty() && this->releases.top()->rt_release <= now) {
+        Thread * thread = this->releases.pop();
+        if (thread->rt_throttled) {
+            thread->rt_throttled = false;
+            ++this->deadline_misses;
+        }
+        this->start_job(*thread, thread->rt_release);
+        if (thread->state == READY && !this->sleeping_threads.contains(thread)) {
+            this->push_ready_thread(*thread);
+        }
+    }
+}
+
+/**
+ * Ends the current job of the running thread, which has a deadline, and waits for the release of its next one.
+ * The job is a deadline miss if it ends after its deadline.
+ */
+void Scheduler::wait_next_period() {
+    Worker & worker = Worker::current();
+    Thread & thread = *worker.running_thread;
+    this->charge_running_thread(worker);
+    if (this->now_nsecs() > thread.rt_abs_deadline) {
+        ++this->deadline_misses;
+    }
+    thread.state = READY;
+    thread.rt_release += thread.rt_period;
+    this->releases.push(&thread);
+    _handle_sleep_threads();
+    this->release_jobs();
+    this->run_next_thread();
+}
+
+/**
+ * @return whether the threads with deadlines still meet them all, by the density bound of global EDF on as many
+ * processors as there are workers, once the thread with ID tid gets a budget of budget every deadline, and no more
+ * than U = M - (M - 1) * u_max, with U the sum of the densities (budget over deadline), u_max the largest one and M
+ * the number of workers. On a single worker this is the exact bound of EDF, U <= 1.
+ */
+bool Scheduler::admits(size_t tid, uint64_t budget, uint64_t deadline) const {
+    double density = (double) budget / (double) deadline;
+    double total = density, largest = density;
+    for (const Thread * thread : this->realtime_threads) {
+        if (thread->tid == tid) {
+            continue;
+        }
+        double other = (double) thread->rt_budget / (double) thread->rt_deadline;
+        total += other;
+        largest = std::max(largest, other);
+    }
+    double workers = (double) this->workers.size();
+    return total <= workers - (workers - 1) * largest;
+}
+
+/**
+ * Gives the thread with ID tid a period, a budget and a relative deadline (in nanoseconds), or takes its deadline
+ * away if period is 0. Its first job is released right away.
+ */
+void Scheduler::set_thread_realtime(size_t tid, uint64_t period, uint64_t budget, uint64_t deadline) {
+    Thread & thread = this->get_thread(tid);
+    RunQueue * queue = thread.run_queue;
+    if (queue != nullptr) {
+        queue->remove(&thread);
+    }
+    bool waiting = this->releases.contains(&thread);
+    this->releases.remove(&thread);
+    thread.rt_throttled = false;
+    thread.rt_period = period;
+    thread.rt_budget = budget;
+    thread.rt_deadline = deadline;
+    if (period == 0) {
+        this->realtime_threads.erase(&thread);
+    } else {
+        this->realtime_threads.insert(&thread);
+        this->start_job(thread, this->now_nsecs());
+    }
+    if (queue != nullptr) {
+        queue->push_back(&thread);
+        for (Worker * worker : this->workers) {
+            if (queue == &worker->ready_threads) {
+                this->preempt_for(*worker, thread);
+            }
+        }
+    } else if (waiting && thread.state == READY && !this->sleeping_threads.contains(&thread)) {
+        this->push_ready_thread(thread);
+    }
+}
+
+unsigned long Scheduler::get_deadline_misses() const {
+    return this->deadline_misses;
+}
+
+int Scheduler::get_policy() const {
+    return this->policy;
+}
+
+void Scheduler::restore_priority(Thread & thread) {
+    thread.attr.priority = thread.base_priority;
+    thread.boost_epoch = this->boost_epoch;
+}
+
+/**
+ * Work stealing only helps a worker whose queue is empty, so threads can still pile up on the workers that spawn
+ * them. This moves READY threads, in the order they would run, from the most loaded worker to the least loaded one
+ * until their loads (queued threads plus the running one) are within one, or balance_max_migrations threads were
+ * moved. The inboxes are drained first, so that the threads waiting there count and may move.
+ * Between workers with the same load, the one that used more CPU since the last pass counts as busier.
+ */
+void Scheduler::balance() {
+    std::vector<size_t> loads;
+    for (Worker * worker : this->workers) {
+        this->drain_inbox(*worker);
+        struct timespec now{};
+        clock_gettime(worker->cpu_clock, &now);
+        long cpu_usecs = now.tv_sec * SECOND + now.tv_nsec / 1000;
+        worker->recent_cpu_usecs = cpu_usecs - worker->last_cpu_usecs;
+        worker->last_cpu_usecs = cpu_usecs;
+        loads.push_back(worker->ready_threads.size() + (worker->running_thread != nullptr ? 1 : 0));
+    }
+    for (int migrations = 0; migrations < this->balance_max_migrations; migrations++) {
+        size_t busiest = 0, idlest = 0;
+        for (size_t id = 1; id < this->workers.size(); id++) {
+            long cpu_usecs = this->workers[id]->recent_cpu_usecs;
+            if (loads[id] > loads[busiest] ||
+                (loads[id] == loads[busiest] && cpu_usecs > this->workers[busiest]->recent_cpu_usecs)) {
+                busiest = id;
+            }
+            if (loads[id] < loads[idlest] ||
+                (loads[id] == loads[idlest] && cpu_usecs < this->workers[idlest]->recent_cpu_usecs)) {
+                idlest = id;
+            }
+        }
+        if (loads[busiest] < loads[idlest] + 2) {
+            return;
+        }
+        Worker & from = *this->workers[busiest];
+        Worker & to = *this->workers[idlest];
+        Thread * thread = from.ready_threads.front();
+        while (thread != nullptr && (thread->attr.worker_mask & to.mask()) == 0) {
+            thread = from.ready_threads.next(thread);
+        }
+        if (thread == nullptr) {
+            return;
+        }
+        from.ready_threads.remove(thread);
+        ++from.migrated_out;
+        ++to.migrated_in;
+        thread->home = &to;
+        this->push_ready_thread(*thread);
+        --loads[busiest];
+        ++loads[idlest];
+    }
+}
+
+/**
+ * Moves the threads other workers handed to the worker into its READY queue. Threads blocked or terminated
+ * while they were waiting in the inbox are dropped, and threads no longer allowed on the worker are passed on.
+ * A worker looking for threads to steal or to balance drains the inboxes of the others too, so that a thread
+ * handed to a busy worker does not wait for it while another worker could run it.
+ */
+void Scheduler::drain_inbox(Worker & worker) {
+    Thread * thread;
+    while ((thread = worker.inbox.pop()) != nullptr) {
+        thread->in_inbox = false;
+        if (thread->terminated) {
+            delete thread;
+        } else if (thread->state == READY) {
+            if ((thread->attr.worker_mask & worker.mask()) == 0) {
+                this->push_ready_thread(*thread);
+                continue;
+            }
+            thread->home = &worker;
+            if (&worker == &Worker::current()) {
+                this->push_ready_thread(*thread);
+            } else {
+                worker.ready_threads.push_back(thread);
+            }
+        }
+    }
+}
+
+/**
+ * Takes the first thread (highest priority, then oldest) the thief may run from the longest READY queue of the
+ * nearest other workers that have one: SMT siblings of the thief's core first, then workers of its node, then the
+ * rest.
+ * @return the stolen thread, or nullptr if no other worker has a READY thread the thief may run.
+ */
+Thread * Scheduler::steal_thread(Worker & thief) {
+    Worker * victim = nullptr;
+    Thread * stolen = nullptr;
+    for (int distance = 0; distance < TOPOLOGY_DISTANCES && stolen == nullptr; distance++) {
+        for (Worker * worker : thief.victims[distance]) {
+            this->drain_inbox(*worker);
+            if (victim != nullptr && worker->ready_threads.size() <= victim->ready_threads.size()) {
+                continue;
+            }
+            for (Thread * thread = worker->ready_threads.front(); thread != nullptr;
+                 thread = worker->ready_threads.next(thread)) {
+                if ((thread->attr.worker_mask & thief.mask()) != 0) {
+                    victim = worker;
+                    stolen = thread;
+                    break;
+                }
+            }
+        }
+    }
+    if (stolen == nullptr) {
+        return nullptr;
+    }
+    ++thief.steals;
+    ++victim->stolen;
+    victim->ready_threads.remove(stolen);
+    return stolen;
+}
+
+/**
+ * Moves the thread of an entry the idle thief stole without the lock to the thief's own queue. A stale entry is
+ * dropped, and a thread the thief may not run goes back to the end of the queue it was stolen from.
+ */
+void Scheduler::claim_stolen_thread(Worker & thief, const StolenThread & stolen) {
+    Thread * thread = stolen.queue->claim(stolen);
+    if (thread == nullptr) {
+        return;
+    }
+    if ((thread->attr.worker_mask & thief.mask()) == 0) {
+        stolen.queue->push_back(thread);
+        return;
+    }
+    for (Worker * victim : this->workers) {
+        if (&victim->ready_threads == stolen.queue) {
+            ++victim->stolen;
+        }
+    }
+    ++thief.steals;
+    thief.ready_threads.push_back(thread);
+}
+
+/**
+ * A thread that terminated itself can only be freed once another thread runs, since it was
+ * still running on its own stack when it was removed.
+ */
+void Scheduler::release_terminated_thread() {
+    Worker & worker = Worker::current();
+    delete worker.terminated_thread;
+    worker.terminated_thread = nullptr;
+}
+
+/**
+ * Runs on a worker that has no thread to run, with the library entered and the lock held.
+ * Once its own queue is empty, the worker steals from the other run queues without the lock, and only looks
+ * under it, where inboxes and the heaps of fair and EDF queues are stolen from too, if that found nothing.
+ * The lock is dropped while waiting, and only taken again once the worker was woken for a thread queued for it,
+ * or stole one. The queues it steals from are copied first, since pinning a worker reorders them.
+ */
+void Scheduler::idle_loop(Worker & worker) {
+    std::vector<RunQueue *> victims;
+    StolenThread stolen;
+    bool has_stolen = false;
+    bool steal_locked = false;
+    while (true) {
+        this->release_terminated_thread();
+        _handle_sleep_threads();
+        this->release_jobs();
+        if (has_stolen) {
+            this->claim_stolen_thread(worker, stolen);
+            has_stolen = false;
+        }
+        uint32_t wakeups = worker.wakeups.load(std::memory_order_relaxed);
+        worker.idle = true;
+        Thread * thread = this->pick_next_thread(worker, steal_locked);
+        if (thread == nullptr && !steal_locked) {
+            victims.clear();
+            for (const std::vector<Worker *> & nearest : worker.victims) {
+                for (Worker * victim : nearest) {
+                    victims.push_back(&victim->ready_threads);
+                }
+            }
+            this->lock.unlock();
+            has_stolen = this->steal_without_lock(victims, stolen);
+            this->lock.lock();
+            steal_locked = !has_stolen;
+            continue;
+        }
+        steal_locked = false;
+        if (thread != nullptr) {
+            worker.idle = false;
+            if (this->charging) {
+                // the time spent idle is charged to no thread
+                this->charge_running_thread(worker);
+            }
+            this->switch_to(worker, &worker.idle_context, thread);
+            continue;
+        }
+        this->stop_time();
+        // an idle worker has no timer, so it wakes up by itself for the next job release
+        uint64_t until_nsecs = this->releases.empty() ? UINT64_MAX : this->releases.top()->rt_release;
+        this->lock.unlock();
+        Worker::set_preemption_pending(false);
+        has_stolen = this->wait_for_work(worker, wakeups, until_nsecs, victims, stolen);
+        this->lock.lock();
+    }
+}
+
+void Scheduler::idle_entry(void * worker) {
+    auto * idle_worker = (Worker *) worker;
+    idle_worker->scheduler->idle_loop(*idle_worker);
+}
+
+/**
+ * Entry point of the kernel threads started for workers 1 and up. They start out idle.
+ */
+void * Scheduler::worker_entry(void * worker) {
+    auto * idle_worker = (Worker *) worker;
+    Worker::set_current(idle_worker);
+    Worker::enter_library();
+    idle_worker->scheduler->lock.lock();
+    idle_worker->scheduler->create_timer(*idle_worker);
+    idle_worker->scheduler->idle_loop(*idle_worker);
+    return nullptr;
+}
+
+/**
+ * Interrupts the thread running on another worker, so that it notices it was blocked or terminated.
+ */
+void Scheduler::kick(Worker & worker) {
+    worker.kicked = true;
+    if (pthread_kill(worker.pthread, SIGVTALRM) != 0) {
+        handleErrorSystemCall((char  *) "pthread_kill error");
+    }
+}
+
+/**
+ * Switches away from the running thread if another worker blocked or terminated it while it was running.
+ * The kick that stopped the thread is served by the switch, so it is not taken for a preemption of the next one.
+ * @return whether the thread was switched out, and so has been resumed since.
+ */
+bool Scheduler::deschedule_stopped_thread() {
+    Worker & worker = Worker::current();
+    Thread * thread = worker.running_thread;
+    if (thread == nullptr) {
+        return false;
+    }
+    if (thread->terminated) {
+        worker.kicked = false;
+        worker.terminated_thread = thread;
+        this->run_next_thread();
+    } else if (thread->state == BLOCKED) {
+        worker.kicked = false;
+        this->run_next_thread();
+        return true;
+    }
+    return false;
+}
+
+
+
+Scheduler::Scheduler(int quantum_usecs, const uthread_config_t & config, void (* callback_handler)(int),
+                     thread_start_routine start_handler) : threads(config.max_threads) {
     this->_callback_handler = callback_handler;
+    this->_start_handler = start_handler;
     this->_quantum_usecs = quantum_usecs;
-    this->running_thread_tid = 0;
+    this->place_workers = config.place_workers != 0;
+    this->idle_spin_usecs = config.idle_spin_usecs;
+    this->balance_interval = config.balance_interval;
+    this->balance_max_migrations = config.balance_max_migrations;
+    this->handoff = config.handoff != 0;
+    this->policy = config.policy;
+    this->charging = config.policy == UTHREAD_SCHED_FAIR || config.policy == UTHREAD_SCHED_EDF;
+    this->boost_interval = config.boost_interval;
+    this->next_boost_quantum = config.boost_interval;
+    this->next_balance_quantum = config.balance_interval;
+    for (size_t id = 0; id < (size_t) config.workers; id++) {
+        this->workers.push_back(new Worker(id, this));
+        this->workers[id]->ready_threads.set_policy(this->policy);
+        this->workers[id]->ready_threads.set_threads(&this->threads);
+        this->all_workers_mask |= this->workers[id]->mask();
+    }
+    // the first pool serves the workers that are not pinned, and every worker when there is a single node, where the
+    // kernel's own placement is kept
+    this->stack_pools.push_back(new StackPool(STACK_POOL_ANY_NODE));
+    int nodes = this->topology.get_node_count();
+    for (int node = 0; nodes > 1 && node < nodes; node++) {
+        this->stack_pools.push_back(new StackPool(node));
+    }
 }
 
 
@@ -95,79 +1038,133 @@ int Scheduler::init_scheduler(){
     struct sigaction sa {};
     // Install timer_handler as the signal handler for SIGVTALRM.
     sa.sa_handler = this->_callback_handler;
+    // SIGVTALRM is never masked: a thread resumed from inside the handler must keep receiving it. Kicks and the
+    // CPU time timers also land in blocking system calls, which are restarted rather than failed with EINTR
+    sa.sa_flags = SA_NODEFER | SA_RESTART;
     if (sigaction(SIGVTALRM, &sa, nullptr) == FAILURE_ERROR)
     {
         fprintf(stderr,"Sigaction error.\n");
         return -1;
     }
-    auto *thread = new Thread(RUNNNING, 1, false);
+    // the calling kernel thread is worker 0, which idles on a stack of its own
+    Worker & main_worker = *this->workers[0];
+    main_worker.pthread = pthread_self();
+    if (this->place_workers && this->workers.size() > 1) {
+        std::vector<int> cpus = this->topology.place_workers(this->workers.size());
+        for (size_t id = 0; id < cpus.size(); id++) {
+            this->workers[id]->cpu = cpus[id];
+            this->workers[id]->node = this->topology.get_node(cpus[id]);
+        }
+        if (main_worker.cpu != WORKER_ANY_CPU && this->pin_worker(0, main_worker.cpu) == FAILURE_ERROR) {
+            return FAILURE_ERROR;
+        }
+    }
+    this->order_victims();
+    Worker::set_current(&main_worker);
+    main_worker.idle_stack = new char[IDLE_STACK_SIZE];
+    context_make(&main_worker.idle_context, main_worker.idle_stack, IDLE_STACK_SIZE, idle_entry, &main_worker);
+
+    // the main thread keeps running on the process stack
+    uthread_attr_t attr{};
+    attr.worker_mask = this->all_workers_mask;
+    attr.priority = DEFAULT_PRIORITY;
+    auto *thread = new Thread(RUNNNING, 1, nullptr, attr);
     if(this->set_thread(0, *thread) == FAILURE_ERROR) {
         return FAILURE_ERROR;
     }
+    thread->worker = &main_worker;
+    thread->home = &main_worker;
+    if (this->charging) {
+        // the CPU time used before the library started is charged to no thread
+        this->charge_running_thread(main_worker);
+    }
+    main_worker.running_thread = thread;
 
-    sigemptyset (&this->set);
-    sigaddset (&this->set, SIGVTALRM);
     ++this->total_quantums;
 
     // Configure the timer to expire after 1 sec... */
     this->timer.it_value.tv_sec = _quantum_usecs / SECOND;        // first time interval, seconds part
-    this->timer.it_value.tv_usec = _quantum_usecs % SECOND;        // first time interval, microseconds part
+    this->timer.it_value.tv_nsec = _quantum_usecs % SECOND * 1000;        // first time interval, nanoseconds part
 
     // configure the timer to expire every 3 sec after that.
     this->timer.it_interval.tv_sec = _quantum_usecs / SECOND;    // following time intervals, seconds part
-    this->timer.it_interval.tv_usec = _quantum_usecs % SECOND;    // following time intervals, microseconds part
+    this->timer.it_interval.tv_nsec = _quantum_usecs % SECOND * 1000;    // following time intervals, nanoseconds part
 
-    if (setitimer(ITIMER_VIRTUAL, &timer, nullptr) == FAILURE_ERROR) {
-        handleErrorSystemCall((char  *) "TIMER ERROR");
+    this->create_timer(main_worker);
+    this->reset_time(*thread);
+
+    this->block_signals();
+    for (size_t id = 1; id < this->workers.size(); id++) {
+        if (pthread_create(&this->workers[id]->pthread, nullptr, worker_entry, this->workers[id]) != 0) {
+            handleErrorSystemCall((char  *) "pthread_create error");
+        }
+        if (this->workers[id]->cpu != WORKER_ANY_CPU) {
+            this->pin_worker(id, this->workers[id]->cpu);
+        }
     }
+    this->unblock_signals();
     return 0;
 }
 
 int Scheduler::set_thread(size_t i, Thread & thread) {
 
-    if (this->threads.size() > MAX_THREAD_NUM) {
+    if (i >= this->threads.get_capacity() || this->threads.contains(i)) {
         return handleErrorLibrary((char  *) "Maximum number of threads delimited");
     }
-    this->threads[i] = &thread;
+    this->threads.set(i, &thread);
+    thread.tid = i;
     return 0;
 }
 
 Thread& Scheduler::get_thread(size_t i) {
-    return *this->threads[i];
+    return *this->threads.get(i);
 }
 
 
-int Scheduler::add_new_thread(State state, size_t quantum, bool allocate_stack, thread_entry_point entry_point) {
-    for (int tid = 0; tid < MAX_THREAD_NUM; tid++) {
-        if (!check_thread(tid)) {
-            auto * thread = new Thread (state, quantum, allocate_stack, entry_point);
-            this->set_thread(tid, *thread);
-            if (state == READY) {
-                this->ready_threads.push_back(tid);
-            }
-            return tid;
-        }
+int Scheduler::add_new_thread(State state, size_t quantum, bool allocate_stack, thread_entry_point entry_point,
+                              const uthread_attr_t & attr) {
+    int tid = this->threads.allocate();
+    if (tid == FAILURE_ERROR) {
+        return FAILURE_ERROR;
     }
-    return -1;
+    StackPool * stack_pool = this->get_stack_pool(Worker::current());
+    auto * thread = new Thread (state, quantum, allocate_stack ? stack_pool : nullptr, attr,
+                                entry_point, this->_start_handler);
+    this->set_thread(tid, *thread);
+    thread->attr.worker_mask &= this->all_workers_mask;
+    thread->home = &Worker::current();
+    if (state == READY) {
+        this->push_ready_thread(*thread);
+    }
+    return tid;
 }
 
 bool Scheduler::check_thread(size_t i) {
-    auto it = this->threads.find(i);
-    return it != this->threads.end();
+    return this->threads.contains(i);
 }
 
 
 
+/**
+ * Enters a library critical section. Instead of masking SIGVTALRM with a syscall, the handler sees the flag
+ * and only records that a preemption is pending. The lock then keeps out the other workers.
+ * A thread that was blocked or terminated by another worker meanwhile is switched out first.
+ */
 int Scheduler::block_signals(){
-    if(sigprocmask(SIG_BLOCK, &this->set, nullptr) == FAILURE_ERROR) {
-        handleErrorSystemCall( (char *) "Signal Block failed");
-    }
+    Worker::enter_library();
+    this->lock.lock();
+    this->deschedule_stopped_thread();
     return 0;
 }
 
+/**
+ * Leaves a library critical section, and makes the switch that was deferred while it was held, if any.
+ */
 int Scheduler::unblock_signals(){
-    if(sigprocmask(SIG_UNBLOCK, &this->set, nullptr) == FAILURE_ERROR) {
-        handleErrorSystemCall((char  *) "Signal Unblock failed");
+    this->lock.unlock();
+    Worker::leave_library();
+    if (Worker::preemption_pending()) {
+        this->change_thread(SIGVTALRM);
     }
     return 0;
 }
@@ -176,39 +1173,53 @@ int Scheduler::get_total_quantums() const {
     return total_quantums;
 }
 
+int Scheduler::get_quantum_usecs() const {
+    return this->_quantum_usecs;
+}
+
 
 int Scheduler::remove_thread(size_t tid) {
     if (!check_thread(tid)) {
         return handleErrorLibrary((char  *) "No thread with Id to remove");
     }
     Thread & thread = get_thread(tid);
-    this->threads.erase(tid);
+    Worker & worker = Worker::current();
+    this->threads.release(tid);
+    this->leave_gang(thread);
+    // whichever worker frees the thread, it no longer counts against admission nor waits for a release
+    this->sleeping_threads.remove(&thread);
+    this->releases.remove(&thread);
+    this->realtime_threads.erase(&thread);
+    if (thread.worker != nullptr && thread.worker != &worker) {
+        // still running on another worker, which frees it once it interrupts the thread
+        thread.terminated = true;
+        this->kick(*thread.worker);
+        return 0;
+    }
+    if (thread.in_inbox) {
+        // freed by the worker whose inbox it is in, once it takes it out
+        thread.terminated = true;
+        return 0;
+    }
     switch (thread.state) {
         case READY:
-            // Removes thread from ready list if state is READY
-            this->remove_thread_from_ready(tid);
+            // Removes thread from ready list if state is READY (a sleeping thread is in none)
+            this->unqueue_thread(thread);
             break;
         case RUNNNING:
-            this->reset_time();
+            worker.terminated_thread = &thread;
             _handle_sleep_threads();
             this->run_next_thread();
             break;
         case BLOCKED:
-            this->blocked_threads.erase(tid);
             break;
     }
-    if(this->sleeping_threads.find(tid) != this->sleeping_threads.end()) {
-        sleeping_threads.erase(tid);
-    }
+    delete &thread;
     return 0;
 }
 
 void Scheduler::remove_thread_from_ready(size_t tid) {
-    for (size_t i = 0; i < this->ready_threads.size(); i++) {
-        if (this->ready_threads[i] == tid) {
-            this->ready_threads.erase(this->ready_threads.begin() + (int) i);
-        }
-    }
+    this->unqueue_thread(this->get_thread(tid));
 }
 
 void Scheduler::block_thread(size_t tid) {
@@ -216,18 +1227,17 @@ void Scheduler::block_thread(size_t tid) {
     switch (thread.state) {
         case READY:
             // Removes thread from ready list if state is READY
-            this->blocked_threads.insert(tid);
             thread.state = BLOCKED;
             this->remove_thread_from_ready(tid);
             break;
         case RUNNNING:
             // saves state
-            this->blocked_threads.insert(tid);
             thread.state = BLOCKED;
-            if (this->save_current_execution_context() == 1) {
-                return;
+            if (thread.worker != &Worker::current()) {
+                // running on another worker, which switches it out once it interrupts the thread
+                this->kick(*thread.worker);
+                break;
             }
-            this->reset_time();
             _handle_sleep_threads();
             this->run_next_thread();
             break;
@@ -241,8 +1251,21 @@ void Scheduler::unblock_thread(size_t tid) {
     Thread & thread = this->get_thread(tid);
     switch (thread.state) {
         case BLOCKED:
+            if (thread.worker != nullptr) {
+                // blocked by another worker before its own worker switched it out, so it just keeps running
+                thread.state = RUNNNING;
+                break;
+            }
+            if (thread.in_inbox) {
+                // blocked while it was handed to another worker, so it is still in that worker's inbox
+                thread.state = READY;
+                break;
+            }
+            if (this->handoff) {
+                this->hand_off_thread(thread);
+                break;
+            }
             this->ready_thread(tid);
-            this->blocked_threads.erase(tid);
             break;
         default:
             break;
@@ -250,25 +1273,196 @@ void Scheduler::unblock_thread(size_t tid) {
 }
 
 int Scheduler::get_running_thread_tid() const {
-    return (int) this->running_thread_tid;
+    return (int) Worker::current().running_thread->tid;
+}
+
+size_t Scheduler::get_running_worker_id() const {
+    return Worker::current().id;
 }
 
 void Scheduler::sleep_running_thread(size_t num_quantums) {
     size_t tid = get_running_thread_tid();
-    this->sleeping_threads[tid] = this->total_quantums + num_quantums + 1;
-    if (this->save_current_execution_context() == 1) {
+    Thread & thread = this->get_thread(tid);
+    thread.wake_quantum = this->total_quantums + num_quantums + 1;
+    this->sleeping_threads.push(&thread);
+    thread.state = READY;
+    _handle_sleep_threads();
+    run_next_thread();
+}
+
+/**
+ * Moves the running thread to the end of the ready list and runs the next one, for a whole time slice of its own.
+ * Does nothing if the running thread is still the next one.
+ */
+void Scheduler::yield_running_thread() {
+    _handle_sleep_threads();
+    Worker & worker = Worker::current();
+    Thread & running_thread = *worker.running_thread;
+    // queued before the next thread is picked, so that a thread that should run after it does not get its slice
+    ready_thread(running_thread.tid);
+    Thread * next_thread = this->pick_next_thread(worker);
+    if (next_thread == &running_thread) {
+        running_thread.state = RUNNNING;
         return;
     }
-    this->get_thread(tid).state = READY;
-    this->reset_time();
-    _handle_sleep_threads();
+    this->run_thread(worker, next_thread);
+}
+
+/**
+ * Restricts the thread with ID tid to the workers in worker_mask. A thread queued or running on a worker it is no
+ * longer allowed on is moved to one it is.
+ */
+void Scheduler::set_thread_affinity(size_t tid, unsigned long long worker_mask) {
+    Thread & thread = this->get_thread(tid);
+    thread.attr.worker_mask = worker_mask & this->all_workers_mask;
+    for (Worker * worker : this->workers) {
+        if (thread.run_queue == &worker->ready_threads && (thread.attr.worker_mask & worker->mask()) == 0) {
+            worker->ready_threads.remove(&thread);
+            this->push_ready_thread(thread);
+        }
+        if (worker->gang_thread == &thread && (thread.attr.worker_mask & worker->mask()) == 0) {
+            worker->gang_thread = nullptr;
+            this->push_ready_thread(thread);
+        }
+        if (worker->run_next == &thread && (thread.attr.worker_mask & worker->mask()) == 0) {
+            worker->run_next = nullptr;
+            this->push_ready_thread(thread);
+        }
+    }
+    if (thread.state != RUNNNING || (thread.attr.worker_mask & thread.worker->mask()) != 0) {
+        return;
+    }
+    if (thread.worker != &Worker::current()) {
+        // the other worker requeues it once it interrupts the thread
+        this->kick(*thread.worker);
+        return;
+    }
+    ready_thread(tid);
     run_next_thread();
 }
 
+unsigned long long Scheduler::get_all_workers_mask() const {
+    return this->all_workers_mask;
+}
+
+/**
+ * Pins the kernel thread of the worker with ID worker to the CPU cpu. The threads it spawns from then on take
+ * their stacks from the pool of the CPU's node.
+ */
+int Scheduler::pin_worker(size_t worker, int cpu) {
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(cpu, &cpus);
+    if (pthread_setaffinity_np(this->workers[worker]->pthread, sizeof(cpus), &cpus) != 0) {
+        return handleErrorLibrary((char  *) "The cpu is invalid");
+    }
+    this->workers[worker]->cpu = cpu;
+    this->workers[worker]->node = this->topology.get_node(cpu);
+    this->order_victims();
+    return 0;
+}
+
+/**
+ * Sorts the other workers of every worker by how far their CPUs are from its own, nearest first, which is the
+ * order it steals from them in.
+ */
+void Scheduler::order_victims() {
+    for (Worker * worker : this->workers) {
+        for (std::vector<Worker *> & victims : worker->victims) {
+            victims.clear();
+        }
+        for (Worker * other : this->workers) {
+            if (other != worker) {
+                worker->victims[this->topology.distance(worker->cpu, other->cpu)].push_back(other);
+            }
+        }
+    }
+}
+
+unsigned long Scheduler::get_gang_coschedules() const {
+    return this->gang_coschedules;
+}
+
+unsigned long Scheduler::get_demotions() const {
+    return this->demotions;
+}
+
+unsigned long Scheduler::get_boosts() const {
+    return this->boosts;
+}
+
+unsigned long Scheduler::get_total_migrations() const {
+    unsigned long migrations = 0;
+    for (Worker * worker : this->workers) {
+        migrations += worker->migrated_in;
+    }
+    return migrations;
+}
+
+unsigned long Scheduler::get_total_steals() const {
+    unsigned long steals = 0;
+    for (Worker * worker : this->workers) {
+        steals += worker->steals;
+    }
+    return steals;
+}
+
+size_t Scheduler::get_worker_count() const {
+    return this->workers.size();
+}
+
+const Worker & Scheduler::get_worker(size_t id) const {
+    return *this->workers[id];
+}
+
+/**
+ * @return the pool of the stacks the threads spawned on worker get: the pool of its node if it is pinned on a
+ * machine with several nodes, else the one whose stacks take memory from the node that first touches it.
+ */
+StackPool * Scheduler::get_stack_pool(const Worker & worker) const {
+    if (worker.node == WORKER_ANY_NODE || this->stack_pools.size() == 1) {
+        return this->stack_pools[0];
+    }
+    return this->stack_pools[1 + worker.node];
+}
+
+unsigned long Scheduler::get_stack_pool_hits() const {
+    unsigned long hits = 0;
+    for (StackPool * stack_pool : this->stack_pools) {
+        hits += stack_pool->get_hits();
+    }
+    return hits;
+}
+
+unsigned long Scheduler::get_stack_pool_misses() const {
+    unsigned long misses = 0;
+    for (StackPool * stack_pool : this->stack_pools) {
+        misses += stack_pool->get_misses();
+    }
+    return misses;
+}
+
+size_t Scheduler::get_total_stack_usage() {
+    size_t total = 0;
+    for (size_t tid = 0; tid < this->threads.get_capacity(); tid++) {
+        if (this->threads.contains(tid)) {
+            total += this->threads.get(tid)->get_stack_usage();
+        }
+    }
+    return total;
+}
+
 void Scheduler::remove_all() {
-    for (auto i: this->threads) {
-        Thread * thread = i.second;
-        delete thread;
+    Worker & worker = Worker::current();
+    for (size_t tid = 0; tid < this->threads.get_capacity(); tid++) {
+        if (this->threads.contains(tid)) {
+            Thread * thread = this->threads.get(tid);
+            // threads running on other workers, and the calling thread itself, still use their stacks until the
+            // process exits
+            if (thread == worker.running_thread || (thread->worker != nullptr && thread->worker != &worker)) {
+                continue;
+            }
+            delete this->threads.release(tid);
+        }
     }
-    this->threads.clear();
 }
\ No newline at end of file
@@ -9,27 +9,111 @@
 #include "uthreads.h"
 #include <map>
 #include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
 #include <set>
 #include "Handle.h"
+#include "SlotTable.h"
+#include "RunQueue.h"
+#include "ThreadHeap.h"
 #include <signal.h>
 #include <queue>
+#include <atomic>
+#include <vector>
+#include <algorithm>
+#include <pthread.h>
+#include "Worker.h"
+#include "SpinLock.h"
+#include "Topology.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CPU_RELAX() __builtin_ia32_pause()
+#else
+#define CPU_RELAX() std::atomic_signal_fence(std::memory_order_seq_cst)
+#endif
+
+#ifndef sigev_notify_thread_id
+#define sigev_notify_thread_id _sigev_un._tid
+#endif
 
 class Scheduler {
 
 private:
-    struct itimerval timer{};
-    sigset_t set{};
+    struct itimerspec timer{};
+    SpinLock lock;
     int total_quantums = 0;
     int _quantum_usecs;
     void (*_callback_handler)(int);
-    size_t running_thread_tid;
-    std::map<size_t, Thread*> threads;
-    std::deque<size_t> ready_threads;
-    std::set<size_t> blocked_threads;
-    std::map<size_t, size_t> sleeping_threads;
+    thread_start_routine _start_handler;
+    std::vector<Worker *> workers;
+    Topology topology;
+    bool place_workers;
+    std::vector<StackPool *> stack_pools;
+    SlotTable threads;
+    ThreadHeap sleeping_threads{&Thread::wake_quantum, &Thread::sleep_index};
+    static void idle_entry(void * worker);
+    static void * worker_entry(void * worker);
+    void idle_loop(Worker & worker);
+    unsigned long long all_workers_mask = 0;
+    long idle_spin_usecs;
+    int balance_interval;
+    int balance_max_migrations;
+    int next_balance_quantum;
+    bool handoff;
+    int policy;
+    int boost_interval;
+    int next_boost_quantum;
+    unsigned long boost_epoch = 0;
+    unsigned long demotions = 0;
+    unsigned long boosts = 0;
+    bool charging;
+    ThreadHeap releases{&Thread::rt_release, &Thread::release_index};
+    std::set<Thread *> realtime_threads;
+    unsigned long deadline_misses = 0;
+    std::map<int, std::vector<Thread *>> gangs;
+    unsigned long gang_coschedules = 0;
+    void switch_to(Worker & worker, Context * from, Thread * new_thread);
+    void run_thread(Worker & worker, Thread * new_thread);
+    Thread * pick_next_thread(Worker & worker, bool steal = true);
+    Thread * steal_thread(Worker & thief);
+    bool steal_without_lock(const std::vector<RunQueue *> & victims, StolenThread & stolen) const;
+    void claim_stolen_thread(Worker & thief, const StolenThread & stolen);
+    void push_ready_thread(Thread & thread);
+    void drain_inbox(Worker & worker);
+    void wake_worker(Worker & worker);
+    bool wait_for_work(Worker & worker, uint32_t wakeups, uint64_t until_nsecs, const std::vector<RunQueue *> & victims,
+                       StolenThread & stolen);
+    void balance_if_due();
+    void balance();
+    void coschedule_gang(Thread & thread, Worker & worker);
+    void deschedule_gang(Thread & thread);
+    void leave_gang(Thread & thread);
+    void unqueue_thread(Thread & thread);
+    void hand_off_thread(Thread & thread);
+    bool runs_before(const Thread & thread, const Thread & other) const;
+    bool runs_ahead(const Thread & thread, const Thread & other) const;
+    void preempt_for(Worker & worker, const Thread & thread);
+    void boost_if_due();
+    void boost();
+    void restore_priority(Thread & thread);
+    void charge_running_thread(Worker & worker);
+    static uint64_t now_nsecs();
+    void start_job(Thread & thread, uint64_t release);
+    void throttle_thread(Thread & thread);
+    bool hold_back(Thread & thread);
+    void release_jobs();
+    void order_victims();
+    bool deschedule_stopped_thread();
+    void kick(Worker & worker);
+    void create_timer(Worker & worker);
+    void stop_time();
+    StackPool * get_stack_pool(const Worker & worker) const;
 
 public:
-    Scheduler(int quantum_usecs, void (* callback_handler)(int));
+    Scheduler(int quantum_usecs, const uthread_config_t & config, void (* callback_handler)(int),
+              thread_start_routine start_handler);
     int set_thread(size_t i, Thread & thread);
     Thread& get_thread(size_t i);
     void change_thread(int signal);
@@ -37,20 +121,45 @@ public:
     int block_signals();
     int unblock_signals();
     int get_total_quantums() const;
+    int get_quantum_usecs() const;
     bool check_thread(size_t);
-    int add_new_thread(State state, size_t quantum, bool allocate_stack, thread_entry_point entry_point);
+    int add_new_thread(State state, size_t quantum, bool allocate_stack, thread_entry_point entry_point,
+                       const uthread_attr_t & attr);
     int remove_thread(size_t);
     void run_next_thread();
     void remove_thread_from_ready(size_t tid);
     void block_thread(size_t tid);
     void unblock_thread(size_t tid);
-    int save_current_execution_context();
     void ready_thread(size_t);
     int get_running_thread_tid() const;
+    size_t get_running_worker_id() const;
     void sleep_running_thread(size_t);
+    void yield_running_thread();
     void _handle_sleep_threads();
     void remove_all();
-    void reset_time();
+    void release_terminated_thread();
+    unsigned long get_stack_pool_hits() const;
+    unsigned long get_stack_pool_misses() const;
+    void set_thread_affinity(size_t tid, unsigned long long worker_mask);
+    unsigned long long get_all_workers_mask() const;
+    int pin_worker(size_t worker, int cpu);
+    unsigned long get_total_steals() const;
+    unsigned long get_total_migrations() const;
+    unsigned long get_gang_coschedules() const;
+    unsigned long get_demotions() const;
+    unsigned long get_boosts() const;
+    void set_thread_gang(size_t tid, int gang);
+    void set_thread_priority(size_t tid, int priority);
+    bool admits(size_t tid, uint64_t budget, uint64_t deadline) const;
+    void set_thread_realtime(size_t tid, uint64_t period, uint64_t budget, uint64_t deadline);
+    void wait_next_period();
+    unsigned long get_deadline_misses() const;
+    int get_policy() const;
+    size_t get_gang_size(int gang) const;
+    size_t get_worker_count() const;
+    const Worker & get_worker(size_t id) const;
+    size_t get_total_stack_usage();
+    void reset_time(const Thread & thread);
 };
 
 
@@ -0,0 +1,103 @@
+#include "SlotTable.h"
+
+#define WORD_BITS 64
+
+SlotTable::SlotTable(size_t capacity) :
+        capacity(capacity), chunks((capacity + SLOT_CHUNK_SIZE - 1) / SLOT_CHUNK_SIZE, nullptr) {
+    // every level has one bit per word of the level below, up to a single word, and all tids start free
+    size_t bits = capacity;
+    do {
+        size_t words = (bits + WORD_BITS - 1) / WORD_BITS;
+        std::vector<uint64_t> level(words, ~(uint64_t) 0);
+        if (bits % WORD_BITS != 0) {
+            level.back() = ((uint64_t) 1 << (bits % WORD_BITS)) - 1;
+        }
+        this->free_bits.push_back(level);
+        bits = words;
+    } while (bits > 1);
+}
+
+SlotTable::~SlotTable() {
+    for (Thread ** chunk : this->chunks) {
+        delete[] chunk;
+    }
+}
+
+/**
+ * Sets the bit of tid in the leaf level and keeps the summary levels in sync.
+ */
+void SlotTable::mark(size_t tid, bool is_free) {
+    size_t index = tid;
+    for (auto & level : this->free_bits) {
+        uint64_t & word = level[index / WORD_BITS];
+        uint64_t bit = (uint64_t) 1 << (index % WORD_BITS);
+        bool was_empty = word == 0;
+        if (is_free) {
+            word |= bit;
+            if (!was_empty) {
+                return;
+            }
+        }
+        else {
+            word &= ~bit;
+            if (word != 0) {
+                return;
+            }
+        }
+        index /= WORD_BITS;
+    }
+}
+
+/**
+ * @return the lowest free tid, or -1 if the table is full. The tid stays free until set.
+ */
+int SlotTable::allocate() {
+    if (this->free_bits.back()[0] == 0) {
+        return -1;
+    }
+    size_t index = 0;
+    for (size_t level = this->free_bits.size(); level-- > 0;) {
+        uint64_t word = this->free_bits[level][index];
+        index = index * WORD_BITS + (size_t) __builtin_ctzll(word);
+    }
+    return (int) index;
+}
+
+void SlotTable::set(size_t tid, Thread * thread) {
+    Thread ** & chunk = this->chunks[tid / SLOT_CHUNK_SIZE];
+    if (chunk == nullptr) {
+        chunk = new Thread * [SLOT_CHUNK_SIZE]();
+    }
+    chunk[tid % SLOT_CHUNK_SIZE] = thread;
+    ++this->count;
+    mark(tid, false);
+}
+
+/**
+ * Frees tid and returns the thread that held it.
+ */
+Thread * SlotTable::release(size_t tid) {
+    Thread * & slot = this->chunks[tid / SLOT_CHUNK_SIZE][tid % SLOT_CHUNK_SIZE];
+    Thread * thread = slot;
+    slot = nullptr;
+    --this->count;
+    mark(tid, true);
+    return thread;
+}
+
+Thread * SlotTable::get(size_t tid) const {
+    return this->chunks[tid / SLOT_CHUNK_SIZE][tid % SLOT_CHUNK_SIZE];
+}
+
+bool SlotTable::contains(size_t tid) const {
+    return tid < this->capacity && this->chunks[tid / SLOT_CHUNK_SIZE] != nullptr &&
+           this->chunks[tid / SLOT_CHUNK_SIZE][tid % SLOT_CHUNK_SIZE] != nullptr;
+}
+
+size_t SlotTable::size() const {
+    return this->count;
+}
+
+size_t SlotTable::get_capacity() const {
+    return this->capacity;
+}
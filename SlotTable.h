@@ -0,0 +1,41 @@
+#ifndef EX2_OS_SLOTTABLE_H
+#define EX2_OS_SLOTTABLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class Thread;
+
+#define SLOT_CHUNK_SIZE 4096 /* slots allocated at once when the table grows */
+
+/**
+ * Threads indexed by tid in a flat table, with a bitmap of the free tids.
+ * The table is split in chunks of SLOT_CHUNK_SIZE slots that are only allocated once one of their tids is used,
+ * so a large capacity costs memory only as threads are actually created.
+ * The bitmap has summary levels (a set bit marks a word below with a free tid),
+ * so the lowest free tid is found by one count-trailing-zeros per level.
+ */
+class SlotTable {
+
+private:
+    size_t capacity;
+    size_t count = 0;
+    std::vector<Thread **> chunks;
+    std::vector<std::vector<uint64_t>> free_bits;
+    void mark(size_t tid, bool is_free);
+
+public:
+    explicit SlotTable(size_t capacity);
+    ~SlotTable();
+    int allocate();
+    void set(size_t tid, Thread * thread);
+    Thread * release(size_t tid);
+    Thread * get(size_t tid) const;
+    bool contains(size_t tid) const;
+    size_t size() const;
+    size_t get_capacity() const;
+};
+
+
+#endif //EX2_OS_SLOTTABLE_H
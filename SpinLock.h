@@ -0,0 +1,35 @@
+#ifndef EX2_OS_SPINLOCK_H
+#define EX2_OS_SPINLOCK_H
+
+#include <atomic>
+#include <sched.h>
+#define SPIN_LOCK_SPINS 128 /* failed attempts before giving the CPU away */
+
+/**
+ * Test-and-set lock for the short critical sections of the library.
+ * It is only taken with preemption deferred, so the holder is never switched out by the timer;
+ * it is however handed over by context switches: whoever resumes after a switch releases it.
+ */
+class SpinLock {
+
+private:
+    std::atomic_flag flag = ATOMIC_FLAG_INIT;
+
+public:
+    void lock() {
+        int spins = 0;
+        while (this->flag.test_and_set(std::memory_order_acquire)) {
+            if (++spins == SPIN_LOCK_SPINS) {
+                spins = 0;
+                sched_yield();
+            }
+        }
+    }
+
+    void unlock() {
+        this->flag.clear(std::memory_order_release);
+    }
+};
+
+
+#endif //EX2_OS_SPINLOCK_H
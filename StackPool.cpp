@@ -0,0 +1,102 @@
+#include "StackPool.h"
+#include "Handle.h"
+#include <sys/mman.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#ifndef MPOL_PREFERRED
+#define MPOL_PREFERRED 1
+#endif
+
+StackPool::StackPool(int node) {
+    this->page_size = (size_t) sysconf(_SC_PAGESIZE);
+    this->node = node;
+}
+
+StackPool::~StackPool() {
+    for (auto & size_class : this->free_stacks) {
+        size_t size = size_class.first.first;
+        size_t guard_size = size_class.first.second;
+        for (char * stack : size_class.second) {
+            munmap(stack - guard_size, guard_size + size);
+        }
+    }
+}
+
+size_t StackPool::round_size(size_t size) const {
+    return (size + this->page_size - 1) / this->page_size * this->page_size;
+}
+
+/**
+ * @return the lowest usable address of a stack of at least size bytes, above at least guard_size
+ * inaccessible bytes.
+ */
+char * StackPool::acquire(size_t size, size_t guard_size) {
+    size = round_size(size);
+    guard_size = round_size(guard_size);
+    auto size_class = this->free_stacks.find(std::make_pair(size, guard_size));
+    if (size_class != this->free_stacks.end() && !size_class->second.empty()) {
+        char * stack = size_class->second.back();
+        size_class->second.pop_back();
+        ++this->hits;
+        return stack;
+    }
+    ++this->misses;
+    void * region = mmap(nullptr, guard_size + size, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK | MAP_NORESERVE, -1, 0);
+    if (region == MAP_FAILED) {
+        handleErrorSystemCall((char  *) "Stack mmap failed");
+    }
+    if (this->node != STACK_POOL_ANY_NODE && this->node < (int) (8 * sizeof(unsigned long))) {
+        // only a preference: where the kernel has no NUMA support the stack just takes memory from anywhere
+        unsigned long nodes = 1UL << this->node;
+        syscall(SYS_mbind, region, guard_size + size, MPOL_PREFERRED, &nodes, 8 * sizeof(nodes), 0);
+    }
+    // the stack grows down, so the guard sits below it
+    if (guard_size > 0 && mprotect(region, guard_size, PROT_NONE) == FAILURE_ERROR) {
+        handleErrorSystemCall((char  *) "Stack guard mprotect failed");
+    }
+    return (char *) region + guard_size;
+}
+
+void StackPool::release(char * stack, size_t size, size_t guard_size) {
+    size = round_size(size);
+    guard_size = round_size(guard_size);
+    std::vector<char *> & size_class = this->free_stacks[std::make_pair(size, guard_size)];
+    if (size_class.size() < STACK_POOL_MAX_FREE) {
+        // the stack grows down, so only its top stays committed for the next thread
+        size_t keep = round_size(STACK_POOL_KEEP_COMMITTED);
+        if (size > keep && madvise(stack, size - keep, MADV_DONTNEED) == FAILURE_ERROR) {
+            handleErrorSystemCall((char  *) "Stack madvise failed");
+        }
+        size_class.push_back(stack);
+        return;
+    }
+    if (munmap(stack - guard_size, guard_size + size) == FAILURE_ERROR) {
+        handleErrorSystemCall((char  *) "Stack munmap failed");
+    }
+}
+
+/**
+ * @return the number of bytes of the stack [stack, stack + size) currently committed in memory.
+ */
+size_t StackPool::committed(char * stack, size_t size) const {
+    size = round_size(size);
+    std::vector<unsigned char> pages(size / this->page_size);
+    if (mincore(stack, size, pages.data()) == FAILURE_ERROR) {
+        handleErrorSystemCall((char  *) "Stack mincore failed");
+    }
+    size_t resident = 0;
+    for (unsigned char page : pages) {
+        resident += page & 1;
+    }
+    return resident * this->page_size;
+}
+
+size_t StackPool::get_hits() const {
+    return this->hits;
+}
+
+size_t StackPool::get_misses() const {
+    return this->misses;
+}
@@ -0,0 +1,40 @@
+#ifndef EX2_OS_STACKPOOL_H
+#define EX2_OS_STACKPOOL_H
+
+#include <cstddef>
+#include <map>
+#include <vector>
+#define STACK_POOL_MAX_FREE 128 /* recycled stacks kept per stack and guard size */
+#define STACK_POOL_KEEP_COMMITTED (16 * 1024) /* bytes at the top of a recycled stack kept committed */
+#define STACK_POOL_ANY_NODE (-1) /* node of a pool whose stacks may take memory from any NUMA node */
+
+/**
+ * Hands out mmap'd thread stacks, each sitting right above a PROT_NONE guard area so that
+ * an overflow faults instead of corrupting the neighbouring memory.
+ * Stacks are only reserved: the kernel commits their pages when they are first touched.
+ * Released stacks are kept on a free list per stack and guard size and reused by the next acquire,
+ * after giving back all but the top STACK_POOL_KEEP_COMMITTED bytes.
+ * A pool may belong to a NUMA node, in which case the memory of its stacks is preferably taken from that node.
+ */
+class StackPool {
+
+private:
+    size_t page_size;
+    int node;
+    size_t hits = 0;
+    size_t misses = 0;
+    std::map<std::pair<size_t, size_t>, std::vector<char *>> free_stacks;
+    size_t round_size(size_t size) const;
+
+public:
+    explicit StackPool(int node = STACK_POOL_ANY_NODE);
+    ~StackPool();
+    char * acquire(size_t size, size_t guard_size);
+    void release(char * stack, size_t size, size_t guard_size);
+    size_t committed(char * stack, size_t size) const;
+    size_t get_hits() const;
+    size_t get_misses() const;
+};
+
+
+#endif //EX2_OS_STACKPOOL_H
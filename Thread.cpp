@@ -4,68 +4,48 @@
 
 #include "Thread.h"
 
-#ifdef __x86_64__
-/* code for 64 bit Intel arch */
-
-typedef unsigned long address_t;
-#define JB_SP 6
-#define JB_PC 7
-
-/* A translation is required when using an address of a variable.
-   Use this as a black box in your code. */
-address_t translate_address(address_t addr)
-{
-    address_t ret;
-    asm volatile("xor    %%fs:0x30,%0\n"
-                 "rol    $0x11,%0\n"
-    : "=g" (ret)
-    : "0" (addr));
-    return ret;
-}
-
-#else
-/* code for 32 bit Intel arch */
-
-typedef unsigned int address_t;
-#define JB_SP 4
-#define JB_PC 5
-
-
-/* A translation is required when using an address of a variable.
-   Use this as a black box in your code. */
-address_t translate_address(address_t addr)
-{
-    address_t ret;
-    asm volatile("xor    %%gs:0x18,%0\n"
-                 "rol    $0x9,%0\n"
-    : "=g" (ret)
-    : "0" (addr));
-    return ret;
-}
-
-
-#endif
-
-Thread::Thread (State state, size_t quantum, bool allocate_stack, thread_entry_point entry_point) {
-    if(allocate_stack) {
-        this->stack = new char[STACK_SIZE];
+/**
+ * A thread created without a stack pool has no stack of its own (the main thread).
+ */
+Thread::Thread (State state, size_t quantum, StackPool * stack_pool, const uthread_attr_t & attr,
+                thread_entry_point entry_point, thread_start_routine start_routine) {
+    this->stack_pool = stack_pool;
+    this->attr = attr;
+    this->base_priority = attr.priority;
+    this->inbox_node.thread = this;
+    if(stack_pool != nullptr) {
+        this->stack = stack_pool->acquire(attr.stack_size, attr.guard_size);
+        // the first switch to this thread calls start_routine(entry_point) on its own stack
+        context_make(&this->context, this->stack, attr.stack_size,
+                     (context_start_routine) start_routine, (void *) entry_point);
     }
     else {
         this->stack = nullptr;
     }
-    address_t sp = (address_t) this->stack + STACK_SIZE - sizeof(address_t);
-    sigsetjmp(this->env, 1);
     this->quantum_t = quantum;
     this->state = state;
-    (this->env->__jmpbuf)[JB_SP] = translate_address(sp);
-    (this->env->__jmpbuf)[JB_PC] = translate_address((address_t) entry_point);
-    sigemptyset(&this->env->__saved_mask);
 }
 
 Thread::~Thread() {
-    delete[] this->stack;
+    if (this->stack_pool != nullptr) {
+        this->stack_pool->release(this->stack, this->attr.stack_size, this->attr.guard_size);
+    }
 }
 
 Thread::Thread() {
+    this->stack = nullptr;
+    this->stack_pool = nullptr;
+}
 
+/**
+ * @return the most stack memory (in bytes) the thread has had committed so far.
+ */
+size_t Thread::get_stack_usage() {
+    if (this->stack_pool != nullptr) {
+        size_t committed = this->stack_pool->committed(this->stack, this->attr.stack_size);
+        if (committed > this->stack_high_water) {
+            this->stack_high_water = committed;
+        }
+    }
+    return this->stack_high_water;
 }
@@ -4,16 +4,19 @@
 
 #ifndef EX2_OS_THREAD_H
 #define EX2_OS_THREAD_H
-typedef void (*thread_entry_point)(void);
 
 #include "iostream"
-#include <setjmp.h>
-#include <signal.h>
+#include "uthreads.h"
+#include "Context.h"
+#include "StackPool.h"
+#include "RunQueue.h"
+#include "ThreadHeap.h"
+#include "Worker.h"
+#include "Inbox.h"
 using namespace std;
-#define MAX_THREAD_NUM 100 /* maximal number of threads */
-#define STACK_SIZE 4096 /* stack size per thread (in bytes) */
 #define SECOND 1000000
-#define STACK_SIZE 4096
+
+typedef void (*thread_start_routine)(thread_entry_point);
 
 
 enum State {
@@ -22,13 +25,52 @@ enum State {
 
 class Thread {
     public :
+        size_t tid = 0;
         State state;
         char * stack;
-        sigjmp_buf env;
+        StackPool * stack_pool;
+        uthread_attr_t attr;
+        Context context{};
         size_t quantum_t;
-        Thread(State state, size_t quantum, bool allocate_stack, thread_entry_point entry_point = nullptr);
+        size_t stack_high_water = 0;
+        // run queue the thread is waiting in, if any, and the level and index of its entry there
+        RunQueue * run_queue = nullptr;
+        int run_priority = 0;
+        int64_t run_index = NOT_IN_RUN_QUEUE;
+        // CPU time charged to the thread under the FAIR policy (in weighted nanoseconds), and its place in a queue
+        uint64_t vruntime = 0;
+        size_t fair_index = NOT_IN_HEAP;
+        // period, budget and relative deadline of the thread under the EDF policy (in nanoseconds, period 0 for
+        // none), the release, absolute deadline and remaining budget of its current job, and its place in the heaps
+        uint64_t rt_period = 0;
+        uint64_t rt_budget = 0;
+        uint64_t rt_deadline = 0;
+        uint64_t rt_release = 0;
+        uint64_t rt_abs_deadline = 0;
+        int64_t rt_remaining = 0;
+        bool rt_throttled = false;
+        size_t deadline_index = NOT_IN_HEAP;
+        size_t release_index = NOT_IN_HEAP;
+        // quantum at which a sleeping thread wakes up, and its place in the heap of sleepers
+        uint64_t wake_quantum = 0;
+        size_t sleep_index = NOT_IN_HEAP;
+        // worker the thread is running on, and whether another worker terminated it meanwhile
+        Worker * worker = nullptr;
+        bool terminated = false;
+        // worker whose queue the thread goes back to when it becomes READY, and its link in that worker's inbox
+        Worker * home = nullptr;
+        InboxNode inbox_node;
+        bool in_inbox = false;
+        // priority the thread was given, which the MLFQ policy lowers attr.priority from, and the last boost it got
+        int base_priority;
+        unsigned long boost_epoch = 0;
+        // gang the thread is co-scheduled with, 0 for none
+        int gang = 0;
+        Thread(State state, size_t quantum, StackPool * stack_pool, const uthread_attr_t & attr,
+               thread_entry_point entry_point = nullptr, thread_start_routine start_routine = nullptr);
         Thread();
         ~Thread();
+        size_t get_stack_usage();
 };
 
 
@@ -0,0 +1,106 @@
+#include "ThreadHeap.h"
+#include "Thread.h"
+
+ThreadHeap::ThreadHeap(uint64_t Thread::* key, size_t Thread::* index) : key(key), index(index) {
+}
+
+void ThreadHeap::place(size_t position, Thread * thread) {
+    this->heap[position] = thread;
+    thread->*this->index = position;
+}
+
+void ThreadHeap::sift_up(size_t position) {
+    Thread * thread = this->heap[position];
+    while (position > 0) {
+        size_t parent = (position - 1) / 2;
+        if (this->heap[parent]->*this->key <= thread->*this->key) {
+            break;
+        }
+        place(position, this->heap[parent]);
+        position = parent;
+    }
+    place(position, thread);
+}
+
+void ThreadHeap::sift_down(size_t position) {
+    Thread * thread = this->heap[position];
+    size_t size = this->heap.size();
+    while (true) {
+        size_t child = 2 * position + 1;
+        if (child >= size) {
+            break;
+        }
+        if (child + 1 < size && this->heap[child + 1]->*this->key < this->heap[child]->*this->key) {
+            ++child;
+        }
+        if (thread->*this->key <= this->heap[child]->*this->key) {
+            break;
+        }
+        place(position, this->heap[child]);
+        position = child;
+    }
+    place(position, thread);
+}
+
+void ThreadHeap::push(Thread * thread) {
+    this->heap.push_back(thread);
+    sift_up(this->heap.size() - 1);
+}
+
+/**
+ * @return the thread with the smallest key, or nullptr if the heap is empty.
+ */
+Thread * ThreadHeap::top() const {
+    return this->heap.empty() ? nullptr : this->heap.front();
+}
+
+/**
+ * @return the thread at position in the heap's array, or nullptr past its end. Walking the positions from 0 visits
+ * every thread, in no particular order beyond the first one having the smallest key.
+ */
+Thread * ThreadHeap::at(size_t position) const {
+    return position < this->heap.size() ? this->heap[position] : nullptr;
+}
+
+/**
+ * Removes and returns the thread with the smallest key, or nullptr if the heap is empty.
+ */
+Thread * ThreadHeap::pop() {
+    Thread * thread = top();
+    if (thread != nullptr) {
+        remove(thread);
+    }
+    return thread;
+}
+
+/**
+ * Removes thread from the heap. Does nothing if thread is not in this heap.
+ */
+void ThreadHeap::remove(Thread * thread) {
+    if (!contains(thread)) {
+        return;
+    }
+    size_t position = thread->*this->index;
+    Thread * last = this->heap.back();
+    this->heap.pop_back();
+    thread->*this->index = NOT_IN_HEAP;
+    if (last == thread) {
+        return;
+    }
+    place(position, last);
+    sift_up(position);
+    sift_down(last->*this->index);
+}
+
+bool ThreadHeap::contains(const Thread * thread) const {
+    size_t position = thread->*this->index;
+    return position < this->heap.size() && this->heap[position] == thread;
+}
+
+bool ThreadHeap::empty() const {
+    return this->heap.empty();
+}
+
+size_t ThreadHeap::size() const {
+    return this->heap.size();
+}
@@ -0,0 +1,40 @@
+#ifndef EX2_OS_THREADHEAP_H
+#define EX2_OS_THREADHEAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class Thread;
+
+#define NOT_IN_HEAP SIZE_MAX
+
+/**
+ * Binary min-heap of threads ordered by one of their uint64_t fields.
+ * Every thread stores its own position in the heap (another of its fields, NOT_IN_HEAP when absent),
+ * so a thread can be removed or re-keyed in O(log n) without searching for it.
+ */
+class ThreadHeap {
+
+private:
+    uint64_t Thread::* key;
+    size_t Thread::* index;
+    std::vector<Thread *> heap;
+    void place(size_t position, Thread * thread);
+    void sift_up(size_t position);
+    void sift_down(size_t position);
+
+public:
+    ThreadHeap(uint64_t Thread::* key, size_t Thread::* index);
+    void push(Thread * thread);
+    Thread * top() const;
+    Thread * at(size_t position) const;
+    Thread * pop();
+    void remove(Thread * thread);
+    bool contains(const Thread * thread) const;
+    bool empty() const;
+    size_t size() const;
+};
+
+
+#endif //EX2_OS_THREADHEAP_H
@@ -0,0 +1,137 @@
+#include "Topology.h"
+#include <cstdio>
+#include <dirent.h>
+#include <fstream>
+#include <sched.h>
+#include <set>
+
+Topology::Topology() {
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+        return;
+    }
+    for (int id = 0; id < CPU_SETSIZE; id++) {
+        if (!CPU_ISSET(id, &allowed)) {
+            continue;
+        }
+        std::string topology = std::string(TOPOLOGY_CPU_ROOT) + "/cpu" + std::to_string(id) + "/topology/";
+        Cpu cpu{id, 0, id, 0};
+        if (!read_int(topology + "physical_package_id", cpu.package) || !read_int(topology + "core_id", cpu.core)) {
+            // no topology for this CPU, so it is taken as a core of its own
+            cpu.package = 0;
+            cpu.core = id;
+        }
+        this->cpus.push_back(cpu);
+    }
+
+    DIR * nodes = opendir(TOPOLOGY_NODE_ROOT);
+    if (nodes == nullptr) {
+        return;
+    }
+    struct dirent * entry;
+    while ((entry = readdir(nodes)) != nullptr) {
+        int node;
+        if (sscanf(entry->d_name, "node%d", &node) != 1) {
+            continue;
+        }
+        if (node + 1 > this->node_count) {
+            this->node_count = node + 1;
+        }
+        for (int id : read_cpu_list(std::string(TOPOLOGY_NODE_ROOT) + "/" + entry->d_name + "/cpulist")) {
+            for (Cpu & cpu : this->cpus) {
+                if (cpu.id == id) {
+                    cpu.node = node;
+                }
+            }
+        }
+    }
+    closedir(nodes);
+}
+
+bool Topology::read_int(const std::string & path, int & value) {
+    std::ifstream file(path);
+    return (bool) (file >> value);
+}
+
+/**
+ * @return the CPUs of a sysfs CPU list such as "0-3,8,10-11", or none if it cannot be read.
+ */
+std::vector<int> Topology::read_cpu_list(const std::string & path) {
+    std::vector<int> list;
+    std::ifstream file(path);
+    std::string range;
+    while (std::getline(file, range, ',')) {
+        int first, last;
+        int fields = sscanf(range.c_str(), "%d-%d", &first, &last);
+        if (fields < 1) {
+            continue;
+        }
+        if (fields == 1) {
+            last = first;
+        }
+        for (int id = first; id <= last; id++) {
+            list.push_back(id);
+        }
+    }
+    return list;
+}
+
+const Topology::Cpu * Topology::find(int cpu) const {
+    for (const Cpu & known : this->cpus) {
+        if (known.id == cpu) {
+            return &known;
+        }
+    }
+    return nullptr;
+}
+
+/**
+ * @return a CPU for each of the workers: one per physical core first, then the remaining SMT siblings, going
+ * around again if there are more workers than CPUs. Empty if no CPU is known.
+ */
+std::vector<int> Topology::place_workers(size_t workers) const {
+    std::vector<int> order;
+    std::vector<int> siblings;
+    std::set<std::pair<int, int>> cores;
+    for (const Cpu & cpu : this->cpus) {
+        if (cores.insert(std::make_pair(cpu.package, cpu.core)).second) {
+            order.push_back(cpu.id);
+        } else {
+            siblings.push_back(cpu.id);
+        }
+    }
+    order.insert(order.end(), siblings.begin(), siblings.end());
+    std::vector<int> placement;
+    for (size_t worker = 0; worker < workers && !order.empty(); worker++) {
+        placement.push_back(order[worker % order.size()]);
+    }
+    return placement;
+}
+
+/**
+ * @return the NUMA node of cpu, 0 if it is not known.
+ */
+int Topology::get_node(int cpu) const {
+    const Cpu * known = this->find(cpu);
+    return known == nullptr ? 0 : known->node;
+}
+
+int Topology::get_node_count() const {
+    return this->node_count;
+}
+
+/**
+ * @return TOPOLOGY_SAME_CORE, TOPOLOGY_SAME_NODE or TOPOLOGY_REMOTE, by what the two CPUs share.
+ */
+int Topology::distance(int cpu, int other_cpu) const {
+    const Cpu * first = this->find(cpu);
+    const Cpu * second = this->find(other_cpu);
+    if (first == nullptr || second == nullptr) {
+        return TOPOLOGY_REMOTE;
+    }
+    if (first->package == second->package && first->core == second->core) {
+        return TOPOLOGY_SAME_CORE;
+    }
+    return first->node == second->node ? TOPOLOGY_SAME_NODE : TOPOLOGY_REMOTE;
+}
@@ -0,0 +1,43 @@
+#ifndef EX2_OS_TOPOLOGY_H
+#define EX2_OS_TOPOLOGY_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#define TOPOLOGY_CPU_ROOT "/sys/devices/system/cpu"
+#define TOPOLOGY_NODE_ROOT "/sys/devices/system/node"
+#define TOPOLOGY_SAME_CORE 0 /* distance between SMT siblings */
+#define TOPOLOGY_SAME_NODE 1 /* distance between CPUs of one NUMA node */
+#define TOPOLOGY_REMOTE 2 /* distance between CPUs of different nodes, or of unknown CPUs */
+#define TOPOLOGY_DISTANCES 3
+
+/**
+ * CPU layout of the machine, read from sysfs: which CPUs are SMT siblings of one physical core, and which
+ * NUMA node each CPU belongs to. Only the CPUs the process may run on are kept.
+ * Where sysfs cannot be read there are no known CPUs and a single node, and nothing is placed.
+ */
+class Topology {
+
+private:
+    struct Cpu {
+        int id;
+        int package;
+        int core;
+        int node;
+    };
+    std::vector<Cpu> cpus;
+    int node_count = 1;
+    const Cpu * find(int cpu) const;
+    static bool read_int(const std::string & path, int & value);
+    static std::vector<int> read_cpu_list(const std::string & path);
+
+public:
+    Topology();
+    std::vector<int> place_workers(size_t workers) const;
+    int get_node(int cpu) const;
+    int get_node_count() const;
+    int distance(int cpu, int other_cpu) const;
+};
+
+
+#endif //EX2_OS_TOPOLOGY_H
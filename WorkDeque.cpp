@@ -0,0 +1,133 @@
+#include "WorkDeque.h"
+
+WorkDeque::Slots::Slots(int64_t capacity) {
+    this->capacity = capacity;
+    this->values = new std::atomic<size_t>[capacity];
+}
+
+WorkDeque::Slots::~Slots() {
+    delete[] this->values;
+}
+
+std::atomic<size_t> & WorkDeque::Slots::at(int64_t index) const {
+    return this->values[index & (this->capacity - 1)];
+}
+
+WorkDeque::WorkDeque() : slots(new Slots(WORK_DEQUE_CAPACITY)) {
+}
+
+WorkDeque::~WorkDeque() {
+    delete this->slots.load(std::memory_order_relaxed);
+    for (Slots * old : this->retired) {
+        delete old;
+    }
+}
+
+/**
+ * Copies the values at indices [first, last) of full to slots twice as large, which replace it.
+ */
+WorkDeque::Slots * WorkDeque::grow(Slots * full, int64_t first, int64_t last) {
+    auto * larger = new Slots(2 * full->capacity);
+    for (int64_t index = first; index < last; index++) {
+        larger->at(index).store(full->at(index).load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+    this->slots.store(larger, std::memory_order_release);
+    this->retired.push_back(full);
+    return larger;
+}
+
+/**
+ * Pushes value at the bottom. Owner only.
+ * @return the index of value, which it keeps until it is popped or stolen.
+ */
+int64_t WorkDeque::push(size_t value) {
+    int64_t last = this->bottom.load(std::memory_order_relaxed);
+    int64_t first = this->top.load(std::memory_order_acquire);
+    Slots * current = this->slots.load(std::memory_order_relaxed);
+    if (last - first > current->capacity - 1) {
+        current = this->grow(current, first, last);
+    }
+    current->at(last).store(value, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    this->bottom.store(last + 1, std::memory_order_relaxed);
+    return last;
+}
+
+/**
+ * Takes the value at the bottom, the one pushed last. Owner only.
+ * @return whether there was one: a thief may win the last value.
+ */
+bool WorkDeque::pop(size_t & value) {
+    int64_t last = this->bottom.load(std::memory_order_relaxed) - 1;
+    Slots * current = this->slots.load(std::memory_order_relaxed);
+    this->bottom.store(last, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t first = this->top.load(std::memory_order_relaxed);
+    if (first > last) {
+        this->bottom.store(last + 1, std::memory_order_relaxed);
+        return false;
+    }
+    value = current->at(last).load(std::memory_order_relaxed);
+    if (first < last) {
+        return true;
+    }
+    bool won = this->top.compare_exchange_strong(first, first + 1, std::memory_order_seq_cst,
+                                                 std::memory_order_relaxed);
+    this->bottom.store(last + 1, std::memory_order_relaxed);
+    return won;
+}
+
+/**
+ * Takes the value at the top, the oldest one, and its index. May be called by anyone, without the lock.
+ * @return whether there was one. Losing a race to another thief only means trying again, so this only fails on
+ * a deque found empty.
+ */
+bool WorkDeque::steal(size_t & value, int64_t & index) {
+    while (true) {
+        int64_t first = this->top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t last = this->bottom.load(std::memory_order_acquire);
+        if (first >= last) {
+            return false;
+        }
+        Slots * current = this->slots.load(std::memory_order_acquire);
+        size_t taken = current->at(first).load(std::memory_order_relaxed);
+        if (this->top.compare_exchange_strong(first, first + 1, std::memory_order_seq_cst,
+                                              std::memory_order_relaxed)) {
+            value = taken;
+            index = first;
+            return true;
+        }
+    }
+}
+
+/**
+ * Reads the value at index without taking it. Owner only.
+ * @return whether index is still in the deque. A thief may take it right after, so the value is only a hint that
+ * must be checked against its index.
+ */
+bool WorkDeque::at(int64_t index, size_t & value) const {
+    if (index < this->top.load(std::memory_order_acquire) || index >= this->bottom.load(std::memory_order_relaxed)) {
+        return false;
+    }
+    value = this->slots.load(std::memory_order_relaxed)->at(index).load(std::memory_order_relaxed);
+    return true;
+}
+
+/**
+ * Overwrites the value at index, if it is still in the deque. Owner only. A thief that read the old value just
+ * before may still take it.
+ */
+void WorkDeque::replace(int64_t index, size_t value) {
+    if (index >= this->top.load(std::memory_order_acquire) && index < this->bottom.load(std::memory_order_relaxed)) {
+        this->slots.load(std::memory_order_relaxed)->at(index).store(value, std::memory_order_relaxed);
+    }
+}
+
+int64_t WorkDeque::get_top() const {
+    return this->top.load(std::memory_order_acquire);
+}
+
+int64_t WorkDeque::get_bottom() const {
+    return this->bottom.load(std::memory_order_relaxed);
+}
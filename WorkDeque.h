@@ -0,0 +1,48 @@
+#ifndef EX2_OS_WORKDEQUE_H
+#define EX2_OS_WORKDEQUE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <vector>
+#define WORK_DEQUE_CAPACITY 16 /* slots of a new deque, doubled whenever it fills up */
+
+/**
+ * Chase-Lev work-stealing deque of thread ids (with the C11 memory orders of Le et al.).
+ * Its owner pushes and pops at the bottom, and anyone steals at the top with a single compare-and-swap, never
+ * waiting for the owner or another thief. Every push gets the next index, which the value keeps while it is in
+ * the deque, so that a value taken out can be told apart from another push of the same id.
+ * Here the owner is whoever holds the library lock: push, pop and at are only called under it, steal is not.
+ * The slots of a full deque are copied to one twice as large, and the old ones are kept until the deque is
+ * destroyed, since a thief may still be reading them.
+ */
+class WorkDeque {
+
+private:
+    struct Slots {
+        int64_t capacity;
+        std::atomic<size_t> * values;
+        explicit Slots(int64_t capacity);
+        ~Slots();
+        std::atomic<size_t> & at(int64_t index) const;
+    };
+    std::atomic<int64_t> top{0};
+    std::atomic<int64_t> bottom{0};
+    std::atomic<Slots *> slots;
+    std::vector<Slots *> retired;
+    Slots * grow(Slots * full, int64_t first, int64_t last);
+
+public:
+    WorkDeque();
+    ~WorkDeque();
+    int64_t push(size_t value);
+    bool pop(size_t & value);
+    bool steal(size_t & value, int64_t & index);
+    bool at(int64_t index, size_t & value) const;
+    void replace(int64_t index, size_t value);
+    int64_t get_top() const;
+    int64_t get_bottom() const;
+};
+
+
+#endif //EX2_OS_WORKDEQUE_H
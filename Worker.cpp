@@ -0,0 +1,61 @@
+#include "Worker.h"
+#include <atomic>
+#include <signal.h>
+
+/*
+ * The accessors below are never inlined: a user-level thread may move to another kernel thread
+ * across a context switch, so the address of a thread local must not be kept across one.
+ */
+#define TLS __attribute__((tls_model("initial-exec")))
+#define NOINLINE __attribute__((noinline))
+
+static thread_local Worker * current_worker TLS = nullptr;
+static thread_local volatile sig_atomic_t library_entered TLS = 0;
+static thread_local volatile sig_atomic_t pending_preemption TLS = 0;
+
+Worker::Worker(size_t id, Scheduler * scheduler) {
+    this->id = id;
+    this->scheduler = scheduler;
+}
+
+Worker::~Worker() {
+    delete[] this->idle_stack;
+}
+
+/**
+ * @return the bit of the worker in worker masks.
+ */
+unsigned long long Worker::mask() const {
+    return 1ULL << this->id;
+}
+
+NOINLINE Worker & Worker::current() {
+    return *current_worker;
+}
+
+NOINLINE void Worker::set_current(Worker * worker) {
+    current_worker = worker;
+}
+
+NOINLINE void Worker::enter_library() {
+    library_entered = 1;
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+}
+
+NOINLINE void Worker::leave_library() {
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+    library_entered = 0;
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+}
+
+NOINLINE bool Worker::in_library() {
+    return library_entered != 0;
+}
+
+NOINLINE void Worker::set_preemption_pending(bool pending) {
+    pending_preemption = pending;
+}
+
+NOINLINE bool Worker::preemption_pending() {
+    return pending_preemption != 0;
+}
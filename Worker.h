@@ -0,0 +1,88 @@
+#ifndef EX2_OS_WORKER_H
+#define EX2_OS_WORKER_H
+
+#include <cstddef>
+#include <pthread.h>
+#include <time.h>
+#include "Context.h"
+#include "RunQueue.h"
+#include "Inbox.h"
+#include "Topology.h"
+#include <vector>
+#include <atomic>
+#include <cstdint>
+#define IDLE_STACK_SIZE (64 * 1024) /* stack of the main worker's idle loop (in bytes) */
+#define WORKER_ANY_CPU (-1) /* cpu of a worker that is not pinned */
+#define WORKER_ANY_NODE (-1) /* node of a worker that is not pinned */
+
+class Thread;
+class Scheduler;
+
+/**
+ * A kernel thread that runs user-level threads. Worker 0 is the thread that called uthread_init,
+ * the others are pthreads started by the scheduler.
+ * Every worker runs the READY threads of its own queue, where the threads it spawns and preempts are put.
+ * A thread made READY again goes back to the worker it last ran on, through that worker's inbox if it is
+ * another one, unless its affinity excludes it. A worker whose queue is empty steals the oldest thread it may
+ * run from the longest other queue, once the other inboxes are drained into their queues, and when there is none
+ * it switches to its idle context, which waits for work on the worker's own stack. An idle worker first steals
+ * from the other queues without the library lock, nearest first, and only claims what it took under the lock.
+ *
+ * The in-library and pending preemption flags belong to the kernel thread, and are kept in thread
+ * local storage so that setting one is a single instruction the timer signal cannot split.
+ */
+class Worker {
+
+public:
+    size_t id;
+    pthread_t pthread{};
+    timer_t timer{};
+    Scheduler * scheduler;
+    Thread * running_thread = nullptr;
+    Thread * terminated_thread = nullptr;
+    RunQueue ready_threads;
+    Inbox inbox;
+    unsigned long steals = 0;
+    unsigned long stolen = 0;
+    // CPU the worker is pinned to and its NUMA node, and the other workers by distance, to steal from
+    int cpu = WORKER_ANY_CPU;
+    int node = WORKER_ANY_NODE;
+    std::vector<Worker *> victims[TOPOLOGY_DISTANCES];
+    // set while the worker looks for a thread to run and has not been woken; wakeups is the futex it parks on
+    bool idle = false;
+    std::atomic<uint32_t> wakeups{0};
+    std::atomic<bool> parked{false};
+    std::atomic<unsigned long> parks{0};
+    // CPU time clock of the kernel thread, and the CPU time it used up to and since the last balancing pass
+    clockid_t cpu_clock{};
+    long last_cpu_usecs = 0;
+    long recent_cpu_usecs = 0;
+    unsigned long migrated_in = 0;
+    unsigned long migrated_out = 0;
+    // member of a gang to run next, alongside its siblings, and whether the worker was preempted for a gang
+    Thread * gang_thread = nullptr;
+    bool gang_kicked = false;
+    // thread resumed by the running thread, to run right after it, and whether the running thread came from there
+    Thread * run_next = nullptr;
+    bool ran_next = false;
+    unsigned long handoffs = 0;
+    // whether the worker was preempted for a reason other than its quantum expiring
+    bool kicked = false;
+    // CPU time of the worker when the running thread was last charged, under the FAIR policy (in nanoseconds)
+    uint64_t charged_nsecs = 0;
+    Context idle_context{};
+    char * idle_stack = nullptr;
+    Worker(size_t id, Scheduler * scheduler);
+    ~Worker();
+    unsigned long long mask() const;
+    static Worker & current();
+    static void set_current(Worker * worker);
+    static void enter_library();
+    static void leave_library();
+    static bool in_library();
+    static void set_preemption_pending(bool pending);
+    static bool preemption_pending();
+};
+
+
+#endif //EX2_OS_WORKER_H
@@ -4,6 +4,11 @@
 #include <random>
 #include <algorithm>
 #include <regex>
+#include <fstream>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <sched.h>
 
 /* !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
  *                        IMPORTANT
@@ -941,4 +946,1194 @@ TEST(Test16, BasicSleepTerminated)
     EXPECT_FALSE(auto_resumed_f);
 
     ASSERT_EXIT(uthread_terminate(0) , ::testing::ExitedWithCode(0), "");
-}
\ No newline at end of file
+}
+TEST(Test17, YieldHandsOffInOrder)
+{
+    int quantums_num = 1000 * MILLISECOND; // long enough for the timer never to preempt during this test
+    initializeLibrary(quantums_num); // Thread-0 is initialized
+
+    // yielding with no other READY thread does not start a new quantum
+    EXPECT_EQ(uthread_yield(), 0);
+    EXPECT_EQ(uthread_get_total_quantums(), 1);
+
+    static std::vector<int> order;
+    auto f = []()
+    {
+        order.push_back(uthread_get_tid());
+        EXPECT_EQ(uthread_yield(), 0);
+        order.push_back(uthread_get_tid());
+        uthread_terminate(uthread_get_tid());
+    };
+
+    EXPECT_EQ(uthread_spawn(f), 1);
+    EXPECT_EQ(uthread_spawn(f), 2);
+
+    EXPECT_EQ(uthread_yield(), 0); // 0 -> 1 -> 2 -> 0
+    EXPECT_EQ(order, std::vector<int>({1, 2}));
+    EXPECT_EQ(uthread_get_total_quantums(), 4);
+    EXPECT_EQ(uthread_get_quantums(0), 2);
+
+    EXPECT_EQ(uthread_yield(), 0); // 0 -> 1 -> 2 -> 0, both terminating themselves
+    EXPECT_EQ(order, std::vector<int>({1, 2, 1, 2}));
+    EXPECT_EQ(uthread_get_total_quantums(), 7);
+
+    ASSERT_EXIT(uthread_terminate(0) , ::testing::ExitedWithCode(0), "");
+}
+
+TEST(Test18, StacksAreRecycled)
+{
+    int quantums_num = 1000 * MILLISECOND;
+    initializeLibrary(quantums_num); // Thread-0 is initialized
+
+    expect_thread_library_error([]() { return uthread_get_stats(nullptr); });
+
+    auto f = []()
+    {
+        uthread_terminate(uthread_get_tid());
+    };
+
+    uthread_stats_t stats;
+    for (int i = 1; i <= 3; ++i) {
+        EXPECT_EQ(uthread_spawn(f), i);
+    }
+    ASSERT_EQ(uthread_get_stats(&stats), 0);
+    EXPECT_EQ(stats.stack_pool_hits, 0ul);
+    EXPECT_EQ(stats.stack_pool_misses, 3ul);
+
+    // two threads are terminated by thread-0, the third one terminates itself
+    EXPECT_EQ(uthread_terminate(1), 0);
+    EXPECT_EQ(uthread_terminate(2), 0);
+    EXPECT_EQ(uthread_yield(), 0);
+
+    for (int i = 1; i <= 3; ++i) {
+        EXPECT_EQ(uthread_spawn(f), i);
+    }
+    ASSERT_EQ(uthread_get_stats(&stats), 0);
+    EXPECT_EQ(stats.stack_pool_hits, 3ul);
+    EXPECT_EQ(stats.stack_pool_misses, 3ul);
+
+    ASSERT_EXIT(uthread_terminate(0) , ::testing::ExitedWithCode(0), "");
+}
+
+TEST(Test19, SpawnWithStackSize)
+{
+    int quantums_num = 1000 * MILLISECOND;
+    initializeLibrary(quantums_num); // Thread-0 is initialized
+
+    uthread_attr_t attr;
+    expect_thread_library_error([]() { return uthread_attr_init(nullptr); });
+    ASSERT_EQ(uthread_attr_init(&attr), 0);
+    EXPECT_EQ(attr.stack_size, (size_t) STACK_SIZE);
+
+    static bool deep_done = false;
+    auto deep = []()
+    {
+        // touches most of a 256KiB stack, far more than STACK_SIZE
+        volatile char buffer[200 * 1024];
+        for (size_t i = 0; i < sizeof(buffer); i += 512) {
+            buffer[i] = (char) i;
+        }
+        deep_done = buffer[512] == (char) 512;
+        uthread_terminate(uthread_get_tid());
+    };
+
+    attr.stack_size = 0;
+    expect_thread_library_error([&]() { return uthread_spawn_ex(deep, &attr); });
+    attr.stack_size = 256 * 1024;
+    EXPECT_EQ(uthread_spawn_ex(deep, &attr), 1);
+    EXPECT_EQ(uthread_yield(), 0);
+    EXPECT_TRUE(deep_done);
+
+    ASSERT_EXIT(uthread_terminate(0) , ::testing::ExitedWithCode(0), "");
+}
+
+TEST(Test20, StackUsageIsCommittedOnTouch)
+{
+    int quantums_num = 1000 * MILLISECOND;
+    initializeLibrary(quantums_num); // Thread-0 is initialized
+
+    static const size_t touched = 128 * 1024;
+    auto f = []()
+    {
+        volatile char buffer[touched];
+        for (size_t i = 0; i < touched; i += 512) {
+            buffer[i] = 1;
+        }
+        EXPECT_EQ(buffer[0], 1);
+        uthread_yield();
+        uthread_terminate(uthread_get_tid());
+    };
+    auto idle = []()
+    {
+        uthread_terminate(uthread_get_tid());
+    };
+
+    EXPECT_EQ(uthread_spawn(f), 1);
+    EXPECT_EQ(uthread_spawn(idle), 2);
+    EXPECT_EQ(uthread_get_stack_usage(0), 0);
+    expect_thread_library_error([]() { return (int) uthread_get_stack_usage(3); });
+
+    // thread-2 never ran, only its initial frame is committed
+    EXPECT_LE(uthread_get_stack_usage(2), 16 * 1024);
+
+    EXPECT_EQ(uthread_yield(), 0); // thread-1 touches its stack, thread-2 terminates
+    EXPECT_GE(uthread_get_stack_usage(1), (long) touched);
+    EXPECT_LT(uthread_get_stack_usage(1), (long) STACK_SIZE);
+
+    uthread_stats_t stats;
+    ASSERT_EQ(uthread_get_stats(&stats), 0);
+    EXPECT_GE(stats.stack_committed, touched);
+    EXPECT_LT(stats.stack_committed, (unsigned long) STACK_SIZE);
+
+    ASSERT_EXIT(uthread_terminate(0) , ::testing::ExitedWithCode(0), "");
+}
+
+TEST(Test21, SleepersWakeByDeadline)
+{
+    int quantums_num = MILLISECOND;
+    initializeLibrary(quantums_num); // Thread-0 is initialized
+
+    static std::vector<int> order;
+    auto f = []()
+    {
+        // thread i sleeps 2 * (6 - i) quantums, so later spawned threads wake up first
+        int tid = uthread_get_tid();
+        uthread_sleep(2 * (6 - tid));
+        order.push_back(tid);
+        uthread_terminate(tid);
+    };
+
+    for (int i = 1; i <= 5; ++i) {
+        EXPECT_EQ(uthread_spawn(f), i);
+    }
+
+    threadQuantumSleep(20);
+    EXPECT_EQ(order, std::vector<int>({5, 4, 3, 2, 1}));
+
+    ASSERT_EXIT(uthread_terminate(0) , ::testing::ExitedWithCode(0), "");
+}
+
+/** Returns the resident memory of the process, in bytes */
+static long residentBytes()
+{
+    std::ifstream statm("/proc/self/statm");
+    long size, resident;
+    statm >> size >> resident;
+    return resident * sysconf(_SC_PAGESIZE);
+}
+
+/**
+ * Spawns a large number of concurrent threads with small, guardless stacks and reports the memory each one costs.
+ * Raise THREAD_COUNT to 1000000 to check the library sustains a million threads (needs roughly 5GB of memory).
+ */
+TEST(Test22, ManyThreadsMemoryOverhead)
+{
+    const int THREAD_COUNT = 100000;
+    uthread_config_t config;
+    expect_thread_library_error([]() { return uthread_config_init(nullptr); });
+    ASSERT_EQ(uthread_config_init(&config), 0);
+    EXPECT_EQ(config.max_threads, MAX_THREAD_NUM);
+    config.max_threads = 0;
+    expect_thread_library_error([&]() { return uthread_init_ex(1000 * MILLISECOND, &config); });
+
+    config.max_threads = THREAD_COUNT + 1;
+    ASSERT_EQ(uthread_init_ex(1000 * MILLISECOND, &config), 0);
+
+    uthread_attr_t attr;
+    ASSERT_EQ(uthread_attr_init(&attr), 0);
+    attr.stack_size = 16 * 1024;
+    attr.guard_size = 0;
+    auto f = []()
+    {
+        uthread_terminate(uthread_get_tid());
+    };
+
+    long before = residentBytes();
+    for (int i = 1; i <= THREAD_COUNT; ++i) {
+        ASSERT_EQ(uthread_spawn_ex(f, &attr), i);
+    }
+    long after = residentBytes();
+    expect_thread_library_error([&]() { return uthread_spawn_ex(f, &attr); });
+
+    long per_thread = (after - before) / THREAD_COUNT;
+    std::cout << "memory overhead per thread: " << per_thread << " bytes" << std::endl;
+    EXPECT_LT(per_thread, 8 * 1024);
+
+    ASSERT_EXIT(uthread_terminate(0) , ::testing::ExitedWithCode(0), "");
+}
+
+TEST(Test23, WorkersRunSharedThreads)
+{
+    const int THREAD_COUNT = 20;
+    uthread_config_t config;
+    ASSERT_EQ(uthread_config_init(&config), 0);
+    EXPECT_EQ(config.workers, 1);
+    config.workers = 0;
+    expect_thread_library_error([&]() { return uthread_init_ex(10 * MILLISECOND, &config); });
+    config.workers = MAX_WORKER_NUM + 1;
+    expect_thread_library_error([&]() { return uthread_init_ex(10 * MILLISECOND, &config); });
+
+    config.workers = 4;
+    ASSERT_EQ(uthread_init_ex(10 * MILLISECOND, &config), 0);
+
+    static std::atomic<int> finished(0);
+    static std::atomic<bool> tids_match(true);
+    static int expected_tid[THREAD_COUNT + 1];
+    auto f = []()
+    {
+        int tid = uthread_get_tid();
+        for (int i = 0; i < 10; ++i) {
+            uthread_yield();
+            if (uthread_get_tid() != tid || expected_tid[tid] != tid) {
+                tids_match = false;
+            }
+        }
+        ++finished;
+    };
+    for (int i = 1; i <= THREAD_COUNT; ++i) {
+        int tid = uthread_spawn(f);
+        ASSERT_EQ(tid, i);
+        expected_tid[tid] = tid;
+    }
+    while (finished < THREAD_COUNT) {}
+    EXPECT_TRUE(tids_match);
+
+    // a thread spinning on another worker can still be blocked, resumed and terminated
+    static std::atomic<int> spins(0);
+    int spinner = uthread_spawn([]()
+    {
+        while (true) {
+            ++spins;
+        }
+    });
+    ASSERT_NE(spinner, -1);
+    while (spins == 0) {}
+    EXPECT_EQ(uthread_block(spinner), 0);
+    EXPECT_EQ(uthread_resume(spinner), 0);
+    EXPECT_EQ(uthread_terminate(spinner), 0);
+    expect_thread_library_error([&]() { return uthread_get_quantums(spinner); });
+
+    ASSERT_EXIT(uthread_terminate(0) , ::testing::ExitedWithCode(0), "");
+}
+
+TEST(Test24, IdleWorkersStealThreads)
+{
+    const int THREAD_COUNT = 30;
+    uthread_config_t config;
+    ASSERT_EQ(uthread_config_init(&config), 0);
+    config.workers = 3;
+    ASSERT_EQ(uthread_init_ex(10 * MILLISECOND, &config), 0);
+
+    uthread_worker_stats_t worker_stats;
+    expect_thread_library_error([&]() { return uthread_get_worker_stats(3, &worker_stats); });
+    expect_thread_library_error([&]() { return uthread_get_worker_stats(0, nullptr); });
+
+    // every thread is spawned onto the queue of the main thread's worker, so the others only run stolen threads
+    static std::atomic<int> finished(0);
+    auto f = []()
+    {
+        for (int i = 0; i < 5; ++i) {
+            uthread_yield();
+        }
+        ++finished;
+    };
+    for (int i = 1; i <= THREAD_COUNT; ++i) {
+        ASSERT_EQ(uthread_spawn(f), i);
+    }
+    while (finished < THREAD_COUNT) {}
+
+    uthread_stats_t stats;
+    ASSERT_EQ(uthread_get_stats(&stats), 0);
+    EXPECT_GT(stats.steals, 0u);
+    unsigned long steals = 0, stolen = 0;
+    for (int worker = 0; worker < 3; ++worker) {
+        ASSERT_EQ(uthread_get_worker_stats(worker, &worker_stats), 0);
+        EXPECT_EQ(worker_stats.ready_threads, 0u);
+        steals += worker_stats.steals;
+        stolen += worker_stats.stolen;
+    }
+    EXPECT_EQ(steals, stats.steals);
+    EXPECT_EQ(stolen, stats.steals);
+
+    ASSERT_EXIT(uthread_terminate(0) , ::testing::ExitedWithCode(0), "");
+}
+
+TEST(Test25, ThreadsStayOnTheirWorkers)
+{
+    uthread_config_t config;
+    ASSERT_EQ(uthread_config_init(&config), 0);
+    config.workers = 3;
+    ASSERT_EQ(uthread_init_ex(10 * MILLISECOND, &config), 0);
+    EXPECT_EQ(uthread_get_worker_id(), 0);
+
+    unsigned long long mask;
+    ASSERT_EQ(uthread_get_affinity(0, &mask), 0);
+    EXPECT_EQ(mask, 7u);
+    expect_thread_library_error([&]() { return uthread_get_affinity(0, nullptr); });
+    expect_thread_library_error([&]() { return uthread_get_affinity(1, &mask); });
+    expect_thread_library_error([]() { return uthread_set_affinity(0, 1ULL << 3); });
+    expect_thread_library_error([]() { return uthread_set_affinity(1, 1); });
+    expect_thread_library_error([]() { return uthread_pin_worker(3, 0); });
+    expect_thread_library_error([]() { return uthread_pin_worker(0, -1); });
+    EXPECT_EQ(uthread_pin_worker(0, 0), 0);
+
+    uthread_attr_t attr;
+    ASSERT_EQ(uthread_attr_init(&attr), 0);
+    attr.worker_mask = 1ULL << 5;
+    expect_thread_library_error([&]() { return uthread_spawn_ex([]() {}, &attr); });
+
+    // pinned threads only ever run on worker 2, whichever worker spawns, wakes or steals them
+    static std::atomic<int> finished(0);
+    static std::atomic<bool> stayed(true);
+    attr.worker_mask = (1ULL << 2) | (1ULL << 7);
+    auto f = []()
+    {
+        for (int i = 0; i < 10; ++i) {
+            if (uthread_get_worker_id() != 2) {
+                stayed = false;
+            }
+            if (i % 3 == 0) {
+                uthread_sleep(1);
+            } else {
+                uthread_yield();
+            }
+        }
+        ++finished;
+    };
+    for (int i = 1; i <= 5; ++i) {
+        ASSERT_EQ(uthread_spawn_ex(f, &attr), 2 * i - 1);
+        ASSERT_EQ(uthread_spawn([]() { for (int j = 0; j < 5; ++j) { uthread_yield(); } ++finished; }), 2 * i);
+    }
+    ASSERT_EQ(uthread_get_affinity(1, &mask), 0);
+    EXPECT_EQ(mask, 1ULL << 2);
+
+    // a thread moves itself to another worker
+    ASSERT_EQ(uthread_set_affinity(0, 1ULL << 1), 0);
+    EXPECT_EQ(uthread_get_worker_id(), 1);
+    while (finished < 10) {}
+    EXPECT_EQ(uthread_get_worker_id(), 1);
+    EXPECT_TRUE(stayed);
+
+    ASSERT_EXIT(uthread_terminate(0) , ::testing::ExitedWithCode(0), "");
+}
+
+TEST(Test26, EveryWorkerPreemptsOnItsOwnTimer)
+{
+    uthread_config_t config;
+    ASSERT_EQ(uthread_config_init(&config), 0);
+    config.workers = 2;
+    ASSERT_EQ(uthread_init_ex(10 * MILLISECOND, &config), 0);
+    ASSERT_EQ(uthread_set_affinity(0, 1ULL << 0), 0);
+
+    // two threads that never give up the CPU share worker 1, so only its timer can switch between them
+    uthread_attr_t attr;
+    ASSERT_EQ(uthread_attr_init(&attr), 0);
+    attr.worker_mask = 1ULL << 1;
+    auto spin = []() { while (true) {} };
+    ASSERT_EQ(uthread_spawn_ex(spin, &attr), 1);
+    ASSERT_EQ(uthread_spawn_ex(spin, &attr), 2);
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while ((uthread_get_quantums(1) < 3 || uthread_get_quantums(2) < 3) &&
+           std::chrono::steady_clock::now() < deadline) {}
+    EXPECT_GE(uthread_get_quantums(1), 3);
+    EXPECT_GE(uthread_get_quantums(2), 3);
+    EXPECT_EQ(uthread_get_worker_id(), 0);
+
+    ASSERT_EXIT(uthread_terminate(0) , ::testing::ExitedWithCode(0), "");
+}
+
+TEST(Test27, ResumedThreadsGoBackToTheirWorker)
+{
+    uthread_config_t config;
+    ASSERT_EQ(uthread_config_init(&config), 0);
+    config.workers = 2;
+    ASSERT_EQ(uthread_init_ex(10 * MILLISECOND, &config), 0);
+    ASSERT_EQ(uthread_set_affinity(0, 1ULL << 0), 0);
+
+    // the counting thread shares worker 1 with a spinner, and is resumed from worker 0 through worker 1's inbox
+    static std::atomic<long> counter(0);
+    static std::atomic<bool> moved(false);
+    uthread_attr_t attr;
+    ASSERT_EQ(uthread_attr_init(&attr), 0);
+    attr.worker_mask = 1ULL << 1;
+    int counting = uthread_spawn_ex([]()
+    {
+        while (true) {
+            ++counter;
+            if (uthread_get_worker_id() != 1) {
+                moved = true;
+            }
+        }
+    }, &attr);
+    ASSERT_EQ(counting, 1);
+    ASSERT_EQ(uthread_spawn_ex([]() { while (true) {} }, &attr), 2);
+    while (counter == 0) {}
+
+    auto wait_until_stopped = []()
+    {
+        long seen;
+        do {
+            seen = counter;
+            usleep(20 * MILLISECOND);
+        } while (counter != seen);
+        return seen;
+    };
+    for (int round = 0; round < 5; ++round) {
+        ASSERT_EQ(uthread_block(counting), 0);
+        long stopped = wait_until_stopped();
+        usleep(20 * MILLISECOND);
+        EXPECT_EQ(counter, stopped);
+        ASSERT_EQ(uthread_resume(counting), 0);
+        while (counter == stopped) {}
+    }
+
+    // blocked, resumed and terminated before worker 1 takes it out of its inbox
+    ASSERT_EQ(uthread_block(counting), 0);
+    wait_until_stopped();
+    ASSERT_EQ(uthread_resume(counting), 0);
+    ASSERT_EQ(uthread_block(counting), 0);
+    ASSERT_EQ(uthread_resume(counting), 0);
+    ASSERT_EQ(uthread_terminate(counting), 0);
+    expect_thread_library_error([&]() { return uthread_get_quantums(counting); });
+    long stopped = wait_until_stopped();
+    usleep(20 * MILLISECOND);
+    EXPECT_EQ(counter, stopped);
+    EXPECT_FALSE(moved);
+
+    ASSERT_EXIT(uthread_terminate(0) , ::testing::ExitedWithCode(0), "");
+}
+
+TEST(Test28, WorkersArePlacedOnDistinctCores)
+{
+    uthread_config_t config;
+    ASSERT_EQ(uthread_config_init(&config), 0);
+    EXPECT_NE(config.place_workers, 0);
+    config.workers = 2;
+    ASSERT_EQ(uthread_init_ex(10 * MILLISECOND, &config), 0);
+
+    cpu_set_t allowed;
+    ASSERT_EQ(sched_getaffinity(0, sizeof(allowed), &allowed), 0);
+    uthread_worker_stats_t first, second;
+    ASSERT_EQ(uthread_get_worker_stats(0, &first), 0);
+    ASSERT_EQ(uthread_get_worker_stats(1, &second), 0);
+    ASSERT_GE(first.cpu, 0);
+    ASSERT_GE(second.cpu, 0);
+    EXPECT_GE(first.node, 0);
+    EXPECT_TRUE(CPU_ISSET(first.cpu, &allowed));
+    EXPECT_TRUE(CPU_ISSET(second.cpu, &allowed));
+    if (CPU_COUNT(&allowed) > 1) {
+        EXPECT_NE(first.cpu, second.cpu);
+    }
+
+    // threads keep running wherever the workers were placed
+    static std::atomic<int> finished(0);
+    for (int i = 1; i <= 10; ++i) {
+        ASSERT_EQ(uthread_spawn([]() { uthread_yield(); ++finished; }), i);
+    }
+    while (finished < 10) {}
+
+    ASSERT_EQ(uthread_pin_worker(1, first.cpu), 0);
+    ASSERT_EQ(uthread_get_worker_stats(1, &second), 0);
+    EXPECT_EQ(second.cpu, first.cpu);
+    EXPECT_EQ(second.node, first.node);
+
+    ASSERT_EXIT(uthread_terminate(0) , ::testing::ExitedWithCode(0), "");
+}
+
+TEST(Test29, IdleWorkersParkBetweenBursts)
+{
+    uthread_config_t config;
+    ASSERT_EQ(uthread_config_init(&config), 0);
+    EXPECT_EQ(config.idle_spin_usecs, IDLE_SPIN_USECS);
+    config.idle_spin_usecs = -1;
+    expect_thread_library_error([&]() { return uthread_init_ex(10 * MILLISECOND, &config); });
+    config.idle_spin_usecs = 100;
+    config.workers = 3;
+    ASSERT_EQ(uthread_init_ex(10 * MILLISECOND, &config), 0);
+
+    static std::atomic<int> finished(0);
+    auto burst = [](int first_tid)
+    {
+        finished = 0;
+        for (int i = 0; i < 20; ++i) {
+            ASSERT_EQ(uthread_spawn([]() { uthread_yield(); ++finished; }), first_tid + i);
+        }
+        while (finished < 20) {}
+    };
+    auto cpu_usecs = []()
+    {
+        struct timespec time{};
+        clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &time);
+        return time.tv_sec * 1000000L + time.tv_nsec / 1000;
+    };
+
+    for (int round = 0; round < 3; ++round) {
+        burst(1);
+        usleep(20 * MILLISECOND);
+        // with every worker but the sleeping main one parked, the process takes no CPU
+        long before = cpu_usecs();
+        usleep(200 * MILLISECOND);
+        EXPECT_LT(cpu_usecs() - before, 20 * MILLISECOND);
+    }
+
+    uthread_worker_stats_t stats;
+    for (int worker = 1; worker < 3; ++worker) {
+        ASSERT_EQ(uthread_get_worker_stats(worker, &stats), 0);
+        EXPECT_GT(stats.parks, 0u);
+    }
+
+    ASSERT_EXIT(uthread_terminate(0) , ::testing::ExitedWithCode(0), "");
+}
+
+TEST(Test30, BalancerSpreadsThreadsOverBusyWorkers)
+{
+    uthread_config_t config;
+    ASSERT_EQ(uthread_config_init(&config), 0);
+    EXPECT_EQ(config.balance_interval, BALANCE_INTERVAL);
+    EXPECT_EQ(config.balance_max_migrations, BALANCE_MAX_MIGRATIONS);
+    config.balance_interval = -1;
+    expect_thread_library_error([&]() { return uthread_init_ex(10 * MILLISECOND, &config); });
+    config.balance_interval = 2;
+    config.balance_max_migrations = 1;
+    config.workers = 2;
+    ASSERT_EQ(uthread_init_ex(5 * MILLISECOND, &config), 0);
+    ASSERT_EQ(uthread_set_affinity(0, 1ULL << 0), 0);
+
+    // worker 1 always has its own spinner to run, so it never steals: only the balancer gives it more threads
+    uthread_attr_t attr;
+    ASSERT_EQ(uthread_attr_init(&attr), 0);
+    attr.worker_mask = 1ULL << 1;
+    ASSERT_EQ(uthread_spawn_ex([]() { while (true) {} }, &attr), 1);
+    static std::atomic<bool> moved(false);
+    for (int i = 2; i <= 7; ++i) {
+        ASSERT_EQ(uthread_spawn([]()
+        {
+            while (true) {
+                if (uthread_get_worker_id() == 1) {
+                    moved = true;
+                }
+            }
+        }), i);
+    }
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(20);
+    while (!moved && std::chrono::steady_clock::now() < deadline) {}
+    EXPECT_TRUE(moved);
+
+    uthread_stats_t stats;
+    uthread_worker_stats_t first, second;
+    ASSERT_EQ(uthread_get_stats(&stats), 0);
+    ASSERT_EQ(uthread_get_worker_stats(0, &first), 0);
+    ASSERT_EQ(uthread_get_worker_stats(1, &second), 0);
+    EXPECT_GT(stats.migrations, 0u);
+    EXPECT_GT(first.migrated_out, 0u);
+    EXPECT_GT(second.migrated_in, 0u);
+    EXPECT_EQ(stats.migrations, first.migrated_in + second.migrated_in);
+    EXPECT_EQ(stats.steals, 0u);
+
+    ASSERT_EXIT(uthread_terminate(0) , ::testing::ExitedWithCode(0), "");
+}
+
+TEST(Test31, GangMembersAreScheduledTogether)
+{
+    uthread_config_t config;
+    ASSERT_EQ(uthread_config_init(&config), 0);
+    config.workers = 3;
+    ASSERT_EQ(uthread_init_ex(5 * MILLISECOND, &config), 0);
+
+    static std::atomic<int> running(0);
+    static std::atomic<bool> together(false);
+    for (int i = 1; i <= 4; ++i) {
+        ASSERT_EQ(uthread_spawn([]()
+        {
+            ++running;
+            while (true) {
+                if (running >= 2) {
+                    together = true;
+                }
+            }
+        }), i);
+    }
+    expect_thread_library_error([]() { return uthread_set_gang(1, -1); });
+    expect_thread_library_error([]() { return uthread_set_gang(5, 1); });
+    expect_thread_library_error([]() { return uthread_get_gang(5); });
+    EXPECT_EQ(uthread_get_gang(1), 0);
+    ASSERT_EQ(uthread_set_gang(1, 7), 0);
+    ASSERT_EQ(uthread_set_gang(2, 7), 0);
+    ASSERT_EQ(uthread_set_gang(3, 7), 0);
+    EXPECT_EQ(uthread_get_gang(2), 7);
+    // a gang holds at most one member per worker
+    expect_thread_library_error([]() { return uthread_set_gang(4, 7); });
+    ASSERT_EQ(uthread_set_gang(3, 0), 0);
+    ASSERT_EQ(uthread_set_gang(4, 7), 0);
+    ASSERT_EQ(uthread_terminate(4), 0);
+    ASSERT_EQ(uthread_set_gang(3, 7), 0);
+
+    uthread_stats_t stats;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(20);
+    do {
+        ASSERT_EQ(uthread_get_stats(&stats), 0);
+    } while ((stats.gang_coschedules == 0 || !together) && std::chrono::steady_clock::now() < deadline);
+    EXPECT_GT(stats.gang_coschedules, 0u);
+    EXPECT_TRUE(together);
+
+    ASSERT_EXIT(uthread_terminate(0) , ::testing::ExitedWithCode(0), "");
+}
+
+TEST(Test32, ResumedThreadRunsRightAfterItsWaker)
+{
+    uthread_config_t config;
+    ASSERT_EQ(uthread_config_init(&config), 0);
+    EXPECT_EQ(config.handoff, 0);
+    config.handoff = 1;
+    ASSERT_EQ(uthread_init_ex(10 * MILLISECOND, &config), 0);
+
+    static std::atomic<int> others(0);
+    static std::atomic<int> others_when_woken(-1);
+    ASSERT_EQ(uthread_spawn([]()
+    {
+        others_when_woken = others.load();
+        while (true) {}
+    }), 1);
+    ASSERT_EQ(uthread_block(1), 0);
+    for (int i = 2; i <= 3; ++i) {
+        ASSERT_EQ(uthread_spawn([]()
+        {
+            ++others;
+            while (true) {}
+        }), i);
+    }
+
+    // thread 1 goes ahead of the threads already queued
+    ASSERT_EQ(uthread_resume(1), 0);
+    ASSERT_EQ(uthread_yield(), 0);
+    while (others < 2) {}
+    EXPECT_EQ(others_when_woken, 0);
+
+    uthread_worker_stats_t stats;
+    ASSERT_EQ(uthread_get_worker_stats(0, &stats), 0);
+    EXPECT_EQ(stats.handoffs, 1u);
+
+    ASSERT_EXIT(uthread_terminate(0) , ::testing::ExitedWithCode(0), "");
+}
+
+TEST(Test33, HigherPriorityThreadsRunFirst)
+{
+    ASSERT_EQ(uthread_init(10 * MILLISECOND), 0);
+    EXPECT_EQ(uthread_get_priority(0), DEFAULT_PRIORITY);
+
+    static std::atomic<int> low_count(0);
+    static std::atomic<int> high_runs(0);
+    uthread_attr_t attr;
+    ASSERT_EQ(uthread_attr_init(&attr), 0);
+    EXPECT_EQ(attr.priority, DEFAULT_PRIORITY);
+    attr.priority = PRIORITY_LEVELS;
+    expect_thread_library_error([&]() { return uthread_spawn_ex([]() {}, &attr); });
+
+    attr.priority = 0;
+    ASSERT_EQ(uthread_spawn_ex([]() { while (true) { ++low_count; } }, &attr), 1);
+    // a thread of higher priority than the spawner runs before the spawn returns
+    attr.priority = DEFAULT_PRIORITY + 4;
+    ASSERT_EQ(uthread_spawn_ex([]()
+    {
+        while (true) {
+            ++high_runs;
+            EXPECT_EQ(uthread_block(uthread_get_tid()), 0);
+        }
+    }, &attr), 2);
+    EXPECT_EQ(high_runs, 1);
+    EXPECT_EQ(uthread_get_priority(2), DEFAULT_PRIORITY + 4);
+    expect_thread_library_error([]() { return uthread_set_priority(1, PRIORITY_LEVELS); });
+    expect_thread_library_error([]() { return uthread_set_priority(1, -1); });
+    expect_thread_library_error([]() { return uthread_set_priority(3, 0); });
+    expect_thread_library_error([]() { return uthread_get_priority(3); });
+
+    // the low priority thread never runs while the main thread has work
+    int quantums = uthread_get_total_quantums();
+    while (uthread_get_total_quantums() < quantums + 3) {}
+    EXPECT_EQ(low_count, 0);
+
+    ASSERT_EQ(uthread_resume(2), 0);
+    EXPECT_EQ(high_runs, 2);
+
+    // at the same priority, the two share the worker again
+    ASSERT_EQ(uthread_set_priority(0, 0), 0);
+    while (low_count == 0) {}
+
+    ASSERT_EXIT(uthread_terminate(0) , ::testing::ExitedWithCode(0), "");
+}
+
+TEST(Test34, MlfqLowersThreadsThatUseUpTheirQuantum)
+{
+    uthread_config_t config;
+    ASSERT_EQ(uthread_config_init(&config), 0);
+    EXPECT_EQ(config.policy, UTHREAD_SCHED_PRIORITY);
+    EXPECT_EQ(config.boost_interval, MLFQ_BOOST_INTERVAL);
+    config.policy = 7;
+    expect_thread_library_error([&]() { return uthread_init_ex(10 * MILLISECOND, &config); });
+    config.policy = UTHREAD_SCHED_MLFQ;
+    config.boost_interval = -1;
+    expect_thread_library_error([&]() { return uthread_init_ex(10 * MILLISECOND, &config); });
+    config.boost_interval = 20;
+    ASSERT_EQ(uthread_init_ex(5 * MILLISECOND, &config), 0);
+
+    static std::atomic<int> interactive_runs(0);
+    ASSERT_EQ(uthread_spawn([]() { while (true) {} }), 1);
+    ASSERT_EQ(uthread_spawn([]()
+    {
+        while (true) {
+            ++interactive_runs;
+            EXPECT_EQ(uthread_block(uthread_get_tid()), 0);
+        }
+    }), 2);
+
+    // the spinning threads sink, while the one that blocks right away keeps its priority
+    while (uthread_get_priority(1) > DEFAULT_PRIORITY - 3) {}
+    EXPECT_EQ(uthread_get_priority(2), DEFAULT_PRIORITY);
+    EXPECT_LT(uthread_get_priority(0), DEFAULT_PRIORITY);
+    EXPECT_EQ(interactive_runs, 1);
+
+    // so it runs as soon as it is resumed
+    ASSERT_EQ(uthread_resume(2), 0);
+    EXPECT_EQ(interactive_runs, 2);
+
+    uthread_stats_t stats;
+    do {
+        ASSERT_EQ(uthread_get_stats(&stats), 0);
+    } while (stats.boosts == 0);
+    EXPECT_GT(stats.demotions, 0u);
+
+    ASSERT_EXIT(uthread_terminate(0) , ::testing::ExitedWithCode(0), "");
+}
+
+TEST(Test35, ThreadsRunForTheirOwnTimeSlices)
+{
+    ASSERT_EQ(uthread_init(10 * MILLISECOND), 0);
+    EXPECT_EQ(uthread_get_time_slice(0), 10 * MILLISECOND);
+
+    static std::atomic<unsigned long> short_spins(0);
+    static std::atomic<unsigned long> long_spins(0);
+    uthread_attr_t attr;
+    ASSERT_EQ(uthread_attr_init(&attr), 0);
+    EXPECT_EQ(attr.time_slice_usecs, 0);
+    attr.time_slice_usecs = -1;
+    expect_thread_library_error([&]() { return uthread_spawn_ex([]() {}, &attr); });
+    attr.time_slice_usecs = 2 * MILLISECOND;
+    ASSERT_EQ(uthread_spawn_ex([]() { while (true) { ++short_spins; } }, &attr), 1);
+    ASSERT_EQ(uthread_spawn([]() { while (true) { ++long_spins; } }), 2);
+    EXPECT_EQ(uthread_get_time_slice(1), 2 * MILLISECOND);
+    expect_thread_library_error([]() { return uthread_set_time_slice(2, -1); });
+    expect_thread_library_error([]() { return uthread_set_time_slice(3, MILLISECOND); });
+    expect_thread_library_error([]() { return uthread_get_time_slice(3); });
+    ASSERT_EQ(uthread_set_time_slice(0, MILLISECOND), 0);
+    EXPECT_EQ(uthread_get_time_slice(0), MILLISECOND);
+
+    // the threads take turns, but each turn lasts its own slice
+    while (uthread_get_quantums(1) < 20) {}
+    EXPECT_GT(long_spins, 2 * short_spins);
+
+    ASSERT_EQ(uthread_set_time_slice(1, 0), 0);
+    EXPECT_EQ(uthread_get_time_slice(1), 10 * MILLISECOND);
+
+    ASSERT_EXIT(uthread_terminate(0) , ::testing::ExitedWithCode(0), "");
+}
+
+TEST(Test36, FairPolicySharesTheCpuByWeight)
+{
+    uthread_config_t config;
+    ASSERT_EQ(uthread_config_init(&config), 0);
+    config.policy = UTHREAD_SCHED_FAIR;
+    ASSERT_EQ(uthread_init_ex(2 * MILLISECOND, &config), 0);
+
+    static std::atomic<unsigned long> light_spins(0);
+    static std::atomic<unsigned long> heavy_spins(0);
+    uthread_attr_t attr;
+    ASSERT_EQ(uthread_attr_init(&attr), 0);
+    ASSERT_EQ(uthread_spawn_ex([]() { while (true) { ++light_spins; } }, &attr), 1);
+    // four levels up weighs 2501 against 1024
+    attr.priority = DEFAULT_PRIORITY + 4;
+    ASSERT_EQ(uthread_spawn_ex([]() { while (true) { ++heavy_spins; } }, &attr), 2);
+
+    // the main thread keeps out of the way, so the two spinners share the CPU
+    ASSERT_EQ(uthread_set_priority(0, 0), 0);
+    while (uthread_get_quantums(1) + uthread_get_quantums(2) < 200) {}
+    EXPECT_GT(heavy_spins, light_spins * 18 / 10);
+    EXPECT_LT(heavy_spins, light_spins * 32 / 10);
+
+    ASSERT_EXIT(uthread_terminate(0) , ::testing::ExitedWithCode(0), "");
+}
+
+TEST(Test37, EdfRunsAdmittedThreadsByDeadline)
+{
+    uthread_config_t config;
+    ASSERT_EQ(uthread_config_init(&config), 0);
+    config.policy = UTHREAD_SCHED_EDF;
+    ASSERT_EQ(uthread_init_ex(10 * MILLISECOND, &config), 0);
+
+    static std::atomic<int> jobs[3];
+    auto periodic = []()
+    {
+        int tid = uthread_get_tid();
+        // waits for its deadline
+        EXPECT_EQ(uthread_block(tid), 0);
+        while (true) {
+            auto end = std::chrono::steady_clock::now() + std::chrono::microseconds(500);
+            while (std::chrono::steady_clock::now() < end) {}
+            ++jobs[tid];
+            EXPECT_EQ(uthread_wait_period(), 0);
+        }
+    };
+    ASSERT_EQ(uthread_spawn(periodic), 1);
+    ASSERT_EQ(uthread_spawn(periodic), 2);
+    ASSERT_EQ(uthread_spawn([]() { while (true) {} }), 3);
+
+    expect_thread_library_error([]() { return uthread_wait_period(); });
+    expect_thread_library_error([]() { return uthread_set_deadline(4, 20 * MILLISECOND, MILLISECOND, 0); });
+    expect_thread_library_error([]() { return uthread_set_deadline(1, 20 * MILLISECOND, -1, 0); });
+    expect_thread_library_error([]() { return uthread_set_deadline(1, 20 * MILLISECOND, 0, 0); });
+    expect_thread_library_error([]() { return uthread_set_deadline(1, 20 * MILLISECOND, 6 * MILLISECOND,
+                                                                   5 * MILLISECOND); });
+    expect_thread_library_error([]() { return uthread_set_deadline(1, 20 * MILLISECOND, MILLISECOND,
+                                                                   30 * MILLISECOND); });
+
+    // admission keeps the total density within 1 on a single worker
+    ASSERT_EQ(uthread_set_deadline(1, 20 * MILLISECOND, 10 * MILLISECOND, 0), 0);
+    ASSERT_EQ(uthread_set_deadline(2, 20 * MILLISECOND, 8 * MILLISECOND, 0), 0);
+    expect_thread_library_error([]() { return uthread_set_deadline(3, 10 * MILLISECOND, 2 * MILLISECOND, 0); });
+    ASSERT_EQ(uthread_set_deadline(3, 10 * MILLISECOND, MILLISECOND, 0), 0);
+    ASSERT_EQ(uthread_resume(1), 0);
+    ASSERT_EQ(uthread_resume(2), 0);
+
+    // the threads with deadlines run their jobs ahead of the main thread, which has none, while thread 3 never
+    // ends its jobs and is held back once its budget is used up
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(20);
+    while ((jobs[1] < 10 || jobs[2] < 10) && std::chrono::steady_clock::now() < deadline) {}
+    EXPECT_GE(jobs[1], 10);
+    EXPECT_GE(jobs[2], 10);
+    uthread_stats_t stats;
+    ASSERT_EQ(uthread_get_stats(&stats), 0);
+    EXPECT_GT(stats.deadline_misses, 0u);
+
+    ASSERT_EQ(uthread_set_deadline(3, 0, 0, 0), 0);
+    ASSERT_EQ(uthread_set_deadline(0, 10 * MILLISECOND, MILLISECOND, 0), 0);
+    ASSERT_EQ(uthread_terminate(3), 0);
+
+    ASSERT_EXIT(uthread_terminate(0) , ::testing::ExitedWithCode(0), "");
+}
+
+TEST(Test38, SpawnedThreadTerminatesTheProcessFromDeepInItsStack)
+{
+    // the death test body runs the library, so the child re-executes the test and arms its own timers
+    ::testing::FLAGS_gtest_death_test_style = "threadsafe";
+
+    uthread_config_t config;
+    ASSERT_EQ(uthread_config_init(&config), 0);
+    config.max_threads = 300;
+    ASSERT_EQ(uthread_init_ex(10 * MILLISECOND, &config), 0);
+
+    // the caller keeps running on its stack while the library is released, so it must not be recycled under it
+    ASSERT_EXIT({
+        for (int i = 1; i <= 200; ++i) {
+            EXPECT_EQ(uthread_spawn([]() { while (true) { uthread_yield(); } }), i);
+        }
+        EXPECT_EQ(uthread_spawn([]()
+        {
+            volatile char frames[200 * 1024];
+            frames[0] = 1;
+            frames[sizeof(frames) - 1] = 1;
+            uthread_terminate(0);
+        }), 201);
+        while (true) {
+            uthread_yield();
+        }
+    }, ::testing::ExitedWithCode(0), "");
+}
+
+TEST(Test39, EdfThreadResumedWhileWaitingForItsPeriodAndTerminated)
+{
+    uthread_config_t config;
+    ASSERT_EQ(uthread_config_init(&config), 0);
+    config.policy = UTHREAD_SCHED_EDF;
+    config.handoff = 1;
+    ASSERT_EQ(uthread_init_ex(10 * MILLISECOND, &config), 0);
+
+    static std::atomic<int> jobs(0);
+    static std::atomic<bool> done(false);
+    ASSERT_EQ(uthread_spawn([]()
+    {
+        for (int i = 0; i < 5; ++i) {
+            ++jobs;
+            EXPECT_EQ(uthread_wait_period(), 0);
+        }
+        done = true;
+    }), 1);
+    ASSERT_EQ(uthread_spawn([]() { while (true) {} }), 2);
+    ASSERT_EQ(uthread_set_deadline(1, 20 * MILLISECOND, 10 * MILLISECOND, 0), 0);
+
+    // resumed while it waits for its next job, the thread is still only queued once that job is released
+    while (jobs < 1) {}
+    ASSERT_EQ(uthread_block(1), 0);
+    ASSERT_EQ(uthread_resume(1), 0);
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(20);
+    while (!done && std::chrono::steady_clock::now() < deadline) {}
+    ASSERT_TRUE(done);
+    // gives the thread the time to return even if it is held back until its next release
+    auto returned = std::chrono::steady_clock::now() + std::chrono::milliseconds(50);
+    while (std::chrono::steady_clock::now() < returned) {}
+    EXPECT_EQ(jobs, 5);
+
+    // the thread whose entry point returned no longer counts against admission
+    ASSERT_EQ(uthread_set_deadline(2, 20 * MILLISECOND, 15 * MILLISECOND, 0), 0);
+    ASSERT_EQ(uthread_set_deadline(2, 0, 0, 0), 0);
+
+    ASSERT_EXIT(uthread_terminate(0) , ::testing::ExitedWithCode(0), "");
+}
+
+TEST(Test40, ThreadBlockedByAnotherWorkerIsDispatchedOncePerResume)
+{
+    uthread_config_t config;
+    ASSERT_EQ(uthread_config_init(&config), 0);
+    config.workers = 2;
+    config.idle_spin_usecs = 0;
+    ASSERT_EQ(uthread_init_ex(1000 * MILLISECOND, &config), 0);
+
+    uthread_attr_t attr;
+    ASSERT_EQ(uthread_attr_init(&attr), 0);
+    attr.worker_mask = 2;
+    ASSERT_EQ(uthread_spawn_ex([]() { while (true) {} }, &attr), 1);
+    while (uthread_get_quantums(1) < 1) {}
+
+    // each time, worker 1 switches the thread out, parks, and runs it once more when it is resumed
+    for (int i = 1; i <= 3; ++i) {
+        int quantums = uthread_get_quantums(1);
+        uthread_worker_stats_t worker_stats;
+        ASSERT_EQ(uthread_get_worker_stats(1, &worker_stats), 0);
+        unsigned long parks = worker_stats.parks;
+        ASSERT_EQ(uthread_block(1), 0);
+        while (worker_stats.parks == parks) {
+            ASSERT_EQ(uthread_get_worker_stats(1, &worker_stats), 0);
+        }
+        ASSERT_EQ(uthread_resume(1), 0);
+        auto settled = std::chrono::steady_clock::now() + std::chrono::milliseconds(50);
+        while (std::chrono::steady_clock::now() < settled) {}
+        EXPECT_EQ(uthread_get_quantums(1), quantums + 1);
+    }
+
+    ASSERT_EXIT(uthread_terminate(0) , ::testing::ExitedWithCode(0), "");
+}
+
+TEST(Test41, YieldKeepsTheCpuFromLowerPriorityThreads)
+{
+    ASSERT_EQ(uthread_init(100 * MILLISECOND), 0);
+
+    uthread_attr_t attr;
+    ASSERT_EQ(uthread_attr_init(&attr), 0);
+    attr.priority = DEFAULT_PRIORITY - 1;
+    ASSERT_EQ(uthread_spawn_ex([]() { while (true) {} }, &attr), 1);
+
+    // the main thread is queued ahead of thread 1, so it is picked right back
+    for (int i = 0; i < 10; ++i) {
+        ASSERT_EQ(uthread_yield(), 0);
+    }
+    EXPECT_EQ(uthread_get_quantums(1), 0);
+    EXPECT_EQ(uthread_get_quantums(0), 1);
+
+    ASSERT_EXIT(uthread_terminate(0) , ::testing::ExitedWithCode(0), "");
+}
+
+TEST(Test42, KickDoesNotInterruptABlockingSystemCall)
+{
+    uthread_config_t config;
+    ASSERT_EQ(uthread_config_init(&config), 0);
+    config.workers = 2;
+    ASSERT_EQ(uthread_init_ex(1000 * MILLISECOND, &config), 0);
+
+    static int fds[2];
+    ASSERT_EQ(pipe(fds), 0);
+    uthread_attr_t attr;
+    ASSERT_EQ(uthread_attr_init(&attr), 0);
+    attr.worker_mask = 2;
+    // once the main thread waits in read, a thread on worker 1 spawns one that preempts it and writes the pipe
+    ASSERT_EQ(uthread_spawn_ex([]()
+    {
+        auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(100);
+        while (std::chrono::steady_clock::now() < end) {}
+        uthread_attr_t writer_attr;
+        EXPECT_EQ(uthread_attr_init(&writer_attr), 0);
+        writer_attr.worker_mask = 1;
+        writer_attr.priority = DEFAULT_PRIORITY + 1;
+        EXPECT_EQ(uthread_spawn_ex([]()
+        {
+            char byte = 1;
+            EXPECT_EQ(write(fds[1], &byte, 1), 1);
+            uthread_terminate(uthread_get_tid());
+        }, &writer_attr), 2);
+        while (true) {}
+    }, &attr), 1);
+
+    char byte = 0;
+    EXPECT_EQ(read(fds[0], &byte, 1), 1);
+    EXPECT_EQ(byte, 1);
+
+    ASSERT_EXIT(uthread_terminate(0) , ::testing::ExitedWithCode(0), "");
+}
+
+TEST(Test43, WorkersThatAreNotPinnedPreferNoNode)
+{
+    uthread_config_t config;
+    ASSERT_EQ(uthread_config_init(&config), 0);
+    ASSERT_EQ(uthread_init_ex(10 * MILLISECOND, &config), 0);
+
+    // a single worker is never placed
+    uthread_worker_stats_t worker_stats;
+    ASSERT_EQ(uthread_get_worker_stats(0, &worker_stats), 0);
+    EXPECT_EQ(worker_stats.cpu, -1);
+    EXPECT_EQ(worker_stats.node, -1);
+
+    // their stacks come from the pool that binds no node, and are recycled from it
+    ASSERT_EQ(uthread_spawn([]() {}), 1);
+    while (uthread_get_quantums(1) != -1) {}
+    uthread_stats_t stats;
+    ASSERT_EQ(uthread_get_stats(&stats), 0);
+    EXPECT_EQ(stats.stack_pool_misses, 1u);
+    ASSERT_EQ(uthread_spawn([]() {}), 1);
+    ASSERT_EQ(uthread_get_stats(&stats), 0);
+    EXPECT_EQ(stats.stack_pool_hits, 1u);
+
+    cpu_set_t allowed;
+    ASSERT_EQ(sched_getaffinity(0, sizeof(allowed), &allowed), 0);
+    int cpu = 0;
+    while (!CPU_ISSET(cpu, &allowed)) {
+        ++cpu;
+    }
+    ASSERT_EQ(uthread_pin_worker(0, cpu), 0);
+    ASSERT_EQ(uthread_get_worker_stats(0, &worker_stats), 0);
+    EXPECT_EQ(worker_stats.cpu, cpu);
+    EXPECT_GE(worker_stats.node, 0);
+
+    ASSERT_EXIT(uthread_terminate(0) , ::testing::ExitedWithCode(0), "");
+}
+
+TEST(Test44, HandoffGivesWayToHigherPriorityThreads)
+{
+    uthread_config_t config;
+    ASSERT_EQ(uthread_config_init(&config), 0);
+    config.handoff = 1;
+    ASSERT_EQ(uthread_init_ex(1000 * MILLISECOND, &config), 0);
+
+    static std::vector<int> order;
+    auto record = []()
+    {
+        while (true) {
+            order.push_back(uthread_get_tid());
+            EXPECT_EQ(uthread_block(uthread_get_tid()), 0);
+        }
+    };
+    uthread_attr_t attr;
+    ASSERT_EQ(uthread_attr_init(&attr), 0);
+    attr.priority = 0;
+    ASSERT_EQ(uthread_spawn_ex(record, &attr), 1);
+    ASSERT_EQ(uthread_block(1), 0);
+    ASSERT_EQ(uthread_spawn(record), 2);
+
+    // thread 1 is handed the CPU, but thread 2, READY at a higher priority, runs first, and the main thread too
+    ASSERT_EQ(uthread_resume(1), 0);
+    ASSERT_EQ(uthread_yield(), 0);
+    EXPECT_EQ(order, std::vector<int>({2}));
+    EXPECT_EQ(uthread_get_quantums(1), 0);
+
+    // a thread handed the CPU by a thread of lower priority preempts it at once
+    ASSERT_EQ(uthread_terminate(1), 0);
+    ASSERT_EQ(uthread_set_priority(0, 0), 0);
+    ASSERT_EQ(uthread_resume(2), 0);
+    EXPECT_EQ(order, std::vector<int>({2, 2}));
+
+    ASSERT_EXIT(uthread_terminate(0) , ::testing::ExitedWithCode(0), "");
+}
+
+TEST(Test45, ThreadHandedToABusyWorkerIsStolenByAnIdleOne)
+{
+    uthread_config_t config;
+    ASSERT_EQ(uthread_config_init(&config), 0);
+    config.workers = 3;
+    config.idle_spin_usecs = 0;
+    ASSERT_EQ(uthread_init_ex(1000 * MILLISECOND, &config), 0);
+
+    static std::atomic<bool> blocking(false);
+    static std::atomic<bool> spinning(false);
+    static std::atomic<bool> resumed(false);
+    uthread_attr_t attr;
+    ASSERT_EQ(uthread_attr_init(&attr), 0);
+    attr.worker_mask = 2;
+    ASSERT_EQ(uthread_spawn_ex([]()
+    {
+        blocking = true;
+        EXPECT_EQ(uthread_block(uthread_get_tid()), 0);
+        resumed = true;
+    }, &attr), 1);
+    while (!blocking) {}
+    usleep(20 * MILLISECOND);
+    ASSERT_EQ(uthread_spawn_ex([]() { spinning = true; while (true) {} }, &attr), 2);
+    while (!spinning) {}
+
+    // thread 1 goes back to worker 1, which is busy for a whole second, so parked worker 2 takes it from its inbox
+    ASSERT_EQ(uthread_set_affinity(1, 7), 0);
+    auto start = std::chrono::steady_clock::now();
+    ASSERT_EQ(uthread_resume(1), 0);
+    while (!resumed && std::chrono::steady_clock::now() < start + std::chrono::seconds(3)) {}
+    EXPECT_TRUE(resumed);
+    auto waited = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+    EXPECT_LT(waited.count(), 500);
+
+    ASSERT_EXIT(uthread_terminate(0) , ::testing::ExitedWithCode(0), "");
+}
+
+TEST(Test46, ThreadsStolenWhileTheirPriorityAndStateChangeRunOnce)
+{
+    uthread_config_t config;
+    ASSERT_EQ(uthread_config_init(&config), 0);
+    config.workers = 3;
+    ASSERT_EQ(uthread_init_ex(10 * MILLISECOND, &config), 0);
+
+    const int threads = 32;
+    static std::atomic<int> runs[threads + 1];
+    static std::atomic<int> done(0);
+    auto work = []()
+    {
+        for (volatile int i = 0; i < 1000000; i++) {}
+        ++runs[uthread_get_tid()];
+        ++done;
+    };
+    uthread_attr_t attr;
+    ASSERT_EQ(uthread_attr_init(&attr), 0);
+    for (int tid = 1; tid <= threads; tid++) {
+        // below the main thread, so that only the other workers run them, stealing them from worker 0
+        attr.priority = tid % DEFAULT_PRIORITY;
+        ASSERT_EQ(uthread_spawn_ex(work, &attr), tid);
+    }
+
+    // the entries of the threads moved between levels and queues meanwhile are left behind, and must not be run
+    for (int round = 0; done < threads; round++) {
+        for (int tid = 1; tid <= threads; tid++) {
+            if (runs[tid] == 0 && uthread_block(tid) == 0) {
+                uthread_set_priority(tid, (tid + round) % DEFAULT_PRIORITY);
+                uthread_resume(tid);
+            }
+        }
+    }
+    for (int tid = 1; tid <= threads; tid++) {
+        EXPECT_EQ(runs[tid], 1);
+    }
+    unsigned long steals = 0, stolen = 0;
+    for (int worker = 0; worker < 3; worker++) {
+        uthread_worker_stats_t stats;
+        ASSERT_EQ(uthread_get_worker_stats(worker, &stats), 0);
+        steals += stats.steals;
+        stolen += stats.stolen;
+    }
+    EXPECT_GT(steals, 0u);
+    EXPECT_EQ(steals, stolen);
+
+    ASSERT_EXIT(uthread_terminate(0) , ::testing::ExitedWithCode(0), "");
+}
@@ -9,6 +9,30 @@ void callback_handler (int signal) {
     scheduler -> change_thread(signal);
 }
 
+/**
+ * First function to run on the stack of every spawned thread.
+ * The thread is entered with signals still blocked by whoever switched to it.
+ * A thread whose entry point returns is terminated.
+ */
+void start_handler (thread_entry_point entry_point) {
+    scheduler -> release_terminated_thread();
+    scheduler -> unblock_signals();
+    entry_point();
+    uthread_terminate(uthread_get_tid());
+}
+
+/**
+ * A forked child only keeps the kernel thread that called fork, so fork waits until no other worker is
+ * in the library: the child could never get the lock otherwise.
+ */
+void fork_prepare_handler () {
+    scheduler -> block_signals();
+}
+
+void fork_release_handler () {
+    scheduler -> unblock_signals();
+}
+
 using namespace std;
 
 /**
@@ -25,10 +49,92 @@ using namespace std;
 */
 
 int uthread_init(int quantum_usecs) {
+    return uthread_init_ex(quantum_usecs, nullptr);
+}
+
+
+/**
+ * @brief Sets config to the defaults used by uthread_init: at most MAX_THREAD_NUM concurrent threads, all run by
+ * the kernel thread that calls uthread_init.
+ *
+ * It is an error to call this function with a null config.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_config_init(uthread_config_t * config) {
+    if (config == nullptr) {
+        return handleErrorLibrary((char  *) "Null config");
+    }
+    config->max_threads = MAX_THREAD_NUM;
+    config->workers = 1;
+    config->place_workers = 1;
+    config->idle_spin_usecs = IDLE_SPIN_USECS;
+    config->balance_interval = BALANCE_INTERVAL;
+    config->balance_max_migrations = BALANCE_MAX_MIGRATIONS;
+    config->handoff = 0;
+    config->policy = UTHREAD_SCHED_PRIORITY;
+    config->boost_interval = MLFQ_BOOST_INTERVAL;
+    return 0;
+}
+
+
+/**
+ * @brief Initializes the thread library like uthread_init, with the library-wide parameters given in config.
+ *
+ * A null config is the same as the defaults set by uthread_config_init. The thread tables start small and grow in
+ * chunks as threads are spawned, so a large max_threads only costs memory once that many threads exist.
+ * With more than one worker, the calling kernel thread becomes worker 0 and workers - 1 more kernel threads are
+ * started, so up to workers threads are RUNNING at once. Each worker has a READY queue of its own, and a worker
+ * whose queue is empty steals threads from the others, nearest first. Unless place_workers is 0, the workers are
+ * pinned to CPUs read from /sys, one per physical core before any SMT sibling. A worker with no thread to run
+ * spins for idle_spin_usecs, then parks until a thread is queued for it. Every balance_interval quantums, up to
+ * balance_max_migrations READY threads are moved from the most loaded worker to the least loaded one. With handoff,
+ * a resumed thread skips its worker's queue and runs as soon as the thread that resumed it leaves the CPU.
+ * Under the UTHREAD_SCHED_MLFQ policy, a thread preempted when its quantum expires drops one priority level, while
+ * one that blocks, sleeps or yields first keeps its level, and every boost_interval quantums all threads are raised
+ * back to the priority they were given. Under the UTHREAD_SCHED_FAIR policy, priorities do not order the threads but
+ * weigh the CPU time they are charged, measured to the nanosecond, and the thread charged least runs next: each
+ * thread gets a share of its worker proportional to its weight, which grows by 25% per priority level. Under the
+ * UTHREAD_SCHED_EDF policy, threads given a deadline by uthread_set_deadline run earliest deadline first.
+ * It is an error to call this function with non-positive quantum_usecs, a non-positive max_threads, a number of
+ * workers outside [1, MAX_WORKER_NUM], a negative idle_spin_usecs, balance_interval, balance_max_migrations or
+ * boost_interval, or an unknown policy.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_init_ex(int quantum_usecs, const uthread_config_t * config) {
     if(quantum_usecs < 0) {
         return handleErrorLibrary((char  *) "non-positive quantum_usecs");
     }
-    scheduler = new Scheduler(quantum_usecs, callback_handler);
+    uthread_config_t default_config;
+    if (config == nullptr) {
+        uthread_config_init(&default_config);
+        config = &default_config;
+    }
+    if (config->max_threads <= 0) {
+        return handleErrorLibrary((char  *) "non-positive max_threads");
+    }
+    if (config->workers <= 0 || config->workers > MAX_WORKER_NUM) {
+        return handleErrorLibrary((char  *) "Invalid number of workers");
+    }
+    if (config->idle_spin_usecs < 0) {
+        return handleErrorLibrary((char  *) "negative idle_spin_usecs");
+    }
+    if (config->balance_interval < 0 || config->balance_max_migrations < 0) {
+        return handleErrorLibrary((char  *) "negative load balancing parameter");
+    }
+    if (config->policy != UTHREAD_SCHED_PRIORITY && config->policy != UTHREAD_SCHED_MLFQ &&
+        config->policy != UTHREAD_SCHED_FAIR && config->policy != UTHREAD_SCHED_EDF) {
+        return handleErrorLibrary((char  *) "Unknown policy");
+    }
+    if (config->boost_interval < 0) {
+        return handleErrorLibrary((char  *) "negative boost_interval");
+    }
+    scheduler = new Scheduler(quantum_usecs, *config, callback_handler, start_handler);
+    if (config->workers > 1 && pthread_atfork(fork_prepare_handler, fork_release_handler,
+                                              fork_release_handler) != 0) {
+        return handleErrorLibrary((char  *) "pthread_atfork error");
+    }
     return scheduler->init_scheduler();
 }
 
@@ -40,19 +146,71 @@ int uthread_init(int quantum_usecs) {
  *
  * The thread is added to the end of the READY threads list.
  * The uthread_spawn function should fail if it would cause the number of concurrent threads to exceed the
- * limit (MAX_THREAD_NUM).
+ * limit (MAX_THREAD_NUM, or the max_threads given to uthread_init_ex).
  * Each thread should be allocated with a stack of size STACK_SIZE bytes.
  * It is an error to call this function with a null entry_point.
  *
  * @return On success, return the ID of the created thread. On failure, return -1.
 */
 int uthread_spawn(thread_entry_point entry_point) {
+    return uthread_spawn_ex(entry_point, nullptr);
+}
+
+
+/**
+ * @brief Sets attr to the defaults used by uthread_spawn: a STACK_SIZE stack above a STACK_GUARD_SIZE guard, any
+ * worker, DEFAULT_PRIORITY and the library's quantum.
+ *
+ * It is an error to call this function with a null attr.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_attr_init(uthread_attr_t * attr) {
+    if (attr == nullptr) {
+        return handleErrorLibrary((char  *) "Null attr");
+    }
+    attr->stack_size = STACK_SIZE;
+    attr->guard_size = STACK_GUARD_SIZE;
+    attr->worker_mask = ~0ULL;
+    attr->priority = DEFAULT_PRIORITY;
+    attr->time_slice_usecs = 0;
+    return 0;
+}
+
+
+/**
+ * @brief Creates a new thread like uthread_spawn, with the per-thread parameters given in attr.
+ *
+ * A null attr is the same as the defaults set by uthread_attr_init.
+ * It is an error to call this function with a null entry_point, with a zero stack_size, with a worker_mask that
+ * has no existing worker, with a priority outside [0, PRIORITY_LEVELS - 1] or with a negative time_slice_usecs.
+ *
+ * @return On success, return the ID of the created thread. On failure, return -1.
+*/
+int uthread_spawn_ex(thread_entry_point entry_point, const uthread_attr_t * attr) {
     // handles null entry_point
-    scheduler->block_signals();
     if(entry_point == nullptr) {
         return handleErrorLibrary((char  *) "Null entry_point");
     }
-    int tid = scheduler->add_new_thread(READY, 0, true, entry_point);
+    uthread_attr_t default_attr;
+    if (attr == nullptr) {
+        uthread_attr_init(&default_attr);
+        attr = &default_attr;
+    }
+    if (attr->stack_size == 0) {
+        return handleErrorLibrary((char  *) "Zero stack_size");
+    }
+    if ((attr->worker_mask & scheduler->get_all_workers_mask()) == 0) {
+        return handleErrorLibrary((char  *) "No worker in worker_mask");
+    }
+    if (attr->priority < 0 || attr->priority >= PRIORITY_LEVELS) {
+        return handleErrorLibrary((char  *) "Invalid priority");
+    }
+    if (attr->time_slice_usecs < 0) {
+        return handleErrorLibrary((char  *) "negative time_slice_usecs");
+    }
+    scheduler->block_signals();
+    int tid = scheduler->add_new_thread(READY, 0, true, entry_point, *attr);
     if (tid == FAILURE_ERROR) {
         handleErrorLibrary((char  *) "Maximum number of threads delimited");
     }
@@ -143,9 +301,10 @@ int uthread_resume(int tid) {
 int uthread_sleep(int num_quantums){
     scheduler->block_signals();
     if(num_quantums <= 0) {
+        scheduler->unblock_signals();
         return handleErrorLibrary((char  *) "non-positive quantum error");
     }
-    if(uthread_get_tid() == 0){
+    if(scheduler->get_running_thread_tid() == 0){
         scheduler->unblock_signals();
         return handleErrorLibrary((char  *) "The main thread can't go on sleep state");
     }
@@ -155,13 +314,323 @@ int uthread_sleep(int num_quantums){
 }
 
 
+/**
+ * @brief Gives up the CPU: the RUNNING thread moves to the end of the READY queue and the next READY thread runs.
+ *
+ * The switch is made directly, without waiting for the timer signal, and counts as the start of a new quantum.
+ * The timer is re-armed, so the next thread runs for a whole time slice of its own.
+ * If the RUNNING thread is still the next to run once queued (no other thread of at least its priority is READY)
+ * the function returns immediately and no new quantum starts.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_yield(){
+    scheduler->block_signals();
+    scheduler->yield_running_thread();
+    scheduler->unblock_signals();
+    return 0;
+}
+
+
+/**
+ * @brief Restricts the thread with ID tid to the workers whose bits are set in worker_mask (bit i for worker i).
+ *
+ * Bits of workers that do not exist are ignored. A READY thread queued on a worker it may no longer run on moves to
+ * the queue of one it may, and a RUNNING thread on such a worker is preempted and moves the same way.
+ * If no thread with ID tid exists, or if worker_mask has no existing worker, it is considered an error.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_set_affinity(int tid, unsigned long long worker_mask) {
+    scheduler->block_signals();
+    if (!scheduler->check_thread(tid)) {
+        scheduler->unblock_signals();
+        return handleErrorLibrary((char  *) "The id is invalid");
+    }
+    if ((worker_mask & scheduler->get_all_workers_mask()) == 0) {
+        scheduler->unblock_signals();
+        return handleErrorLibrary((char  *) "No worker in worker_mask");
+    }
+    scheduler->set_thread_affinity(tid, worker_mask);
+    scheduler->unblock_signals();
+    return 0;
+}
+
+
+/**
+ * @brief Stores in worker_mask the workers the thread with ID tid may run on (bit i for worker i).
+ *
+ * It is an error to call this function with a null worker_mask or if no thread with ID tid exists.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_get_affinity(int tid, unsigned long long * worker_mask) {
+    if (worker_mask == nullptr) {
+        return handleErrorLibrary((char  *) "Null worker_mask");
+    }
+    scheduler->block_signals();
+    if (!scheduler->check_thread(tid)) {
+        scheduler->unblock_signals();
+        return handleErrorLibrary((char  *) "The id is invalid");
+    }
+    *worker_mask = scheduler->get_thread(tid).attr.worker_mask;
+    scheduler->unblock_signals();
+    return 0;
+}
+
+
+/**
+ * @brief Sets the priority of the thread with ID tid, in [0, PRIORITY_LEVELS - 1].
+ *
+ * A worker always runs its READY thread of highest priority first, round-robin among threads of equal priority.
+ * Under the MLFQ policy this is the thread's own priority, which it falls below as it uses up quantums.
+ * A worker running a thread of lower priority than a thread that becomes READY on it is preempted at once.
+ * Under the FAIR policy the priority is instead the weight of the thread's share of the CPU.
+ * If no thread with ID tid exists, or if priority is out of range, it is considered an error.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_set_priority(int tid, int priority) {
+    if (priority < 0 || priority >= PRIORITY_LEVELS) {
+        return handleErrorLibrary((char  *) "Invalid priority");
+    }
+    scheduler->block_signals();
+    if (!scheduler->check_thread(tid)) {
+        scheduler->unblock_signals();
+        return handleErrorLibrary((char  *) "The id is invalid");
+    }
+    scheduler->set_thread_priority(tid, priority);
+    scheduler->unblock_signals();
+    return 0;
+}
+
+
+/**
+ * @brief Returns the priority of the thread with ID tid, as lowered by the MLFQ policy.
+ *
+ * It is an error to call this function with a tid of a thread that does not exist.
+ *
+ * @return On success, return the priority of the thread. On failure, return -1.
+*/
+int uthread_get_priority(int tid) {
+    scheduler->block_signals();
+    if (!scheduler->check_thread(tid)) {
+        scheduler->unblock_signals();
+        return handleErrorLibrary((char  *) "The id is invalid");
+    }
+    int priority = scheduler->get_thread(tid).attr.priority;
+    scheduler->unblock_signals();
+    return priority;
+}
+
+
+/**
+ * @brief Sets the length of the quantums of the thread with ID tid, or gives it the library's quantum again if
+ * time_slice_usecs is 0.
+ *
+ * Long slices suit batch threads, which are then switched out less often, and short slices suit threads that must
+ * leave the CPU to others quickly. The new length applies from the next time the thread is dispatched.
+ * If no thread with ID tid exists, or if time_slice_usecs is negative, it is considered an error.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_set_time_slice(int tid, int time_slice_usecs) {
+    if (time_slice_usecs < 0) {
+        return handleErrorLibrary((char  *) "negative time_slice_usecs");
+    }
+    scheduler->block_signals();
+    if (!scheduler->check_thread(tid)) {
+        scheduler->unblock_signals();
+        return handleErrorLibrary((char  *) "The id is invalid");
+    }
+    scheduler->get_thread(tid).attr.time_slice_usecs = time_slice_usecs;
+    scheduler->unblock_signals();
+    return 0;
+}
+
+
+/**
+ * @brief Returns the length of the quantums of the thread with ID tid (in micro-seconds).
+ *
+ * It is an error to call this function with a tid of a thread that does not exist.
+ *
+ * @return On success, return the length of the thread's quantums. On failure, return -1.
+*/
+int uthread_get_time_slice(int tid) {
+    scheduler->block_signals();
+    if (!scheduler->check_thread(tid)) {
+        scheduler->unblock_signals();
+        return handleErrorLibrary((char  *) "The id is invalid");
+    }
+    int time_slice_usecs = scheduler->get_thread(tid).attr.time_slice_usecs;
+    if (time_slice_usecs == 0) {
+        time_slice_usecs = scheduler->get_quantum_usecs();
+    }
+    scheduler->unblock_signals();
+    return time_slice_usecs;
+}
+
+
+/**
+ * @brief Gives the thread with ID tid a deadline under the UTHREAD_SCHED_EDF policy: a job is released every
+ * period_usecs, which must be done within budget_usecs of CPU time by deadline_usecs after its release.
+ *
+ * A deadline_usecs of 0 is the same as period_usecs, and a period_usecs of 0 takes the thread's deadline away.
+ * The first job is released at once, and each later one once the thread called uthread_wait_period. A worker always
+ * runs its READY thread of earliest deadline first, ahead of the threads without one, which run by priority.
+ * A thread that uses up its budget waits for its next job, and the job counts as a deadline miss.
+ * The thread is only admitted if, with it, the sum U of budget over deadline of all threads with deadlines, the
+ * largest of which is u_max, is at most M - (M - 1) * u_max on M workers, so that their deadlines can be met.
+ * It is an error if the policy is not UTHREAD_SCHED_EDF, if no thread with ID tid exists, if budget_usecs is not
+ * positive or exceeds deadline_usecs, if deadline_usecs exceeds period_usecs, if a value is negative, or if the
+ * thread is not admitted.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_set_deadline(int tid, int period_usecs, int budget_usecs, int deadline_usecs) {
+    if (scheduler->get_policy() != UTHREAD_SCHED_EDF) {
+        return handleErrorLibrary((char  *) "The policy is not EDF");
+    }
+    if (period_usecs < 0 || budget_usecs < 0 || deadline_usecs < 0) {
+        return handleErrorLibrary((char  *) "Negative real-time parameter");
+    }
+    if (deadline_usecs == 0) {
+        deadline_usecs = period_usecs;
+    }
+    if (period_usecs != 0 && (budget_usecs == 0 || budget_usecs > deadline_usecs || deadline_usecs > period_usecs)) {
+        return handleErrorLibrary((char  *) "Invalid real-time parameters");
+    }
+    scheduler->block_signals();
+    if (!scheduler->check_thread(tid)) {
+        scheduler->unblock_signals();
+        return handleErrorLibrary((char  *) "The id is invalid");
+    }
+    if (period_usecs != 0 && !scheduler->admits(tid, budget_usecs, deadline_usecs)) {
+        scheduler->unblock_signals();
+        return handleErrorLibrary((char  *) "The thread would make deadlines be missed");
+    }
+    scheduler->set_thread_realtime(tid, (uint64_t) period_usecs * 1000, (uint64_t) budget_usecs * 1000,
+                                   (uint64_t) deadline_usecs * 1000);
+    scheduler->unblock_signals();
+    return 0;
+}
+
+
+/**
+ * @brief Ends the current job of the calling thread, which has a deadline, and waits for its next job's release.
+ *
+ * It is an error to call this function from a thread without a deadline.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_wait_period() {
+    scheduler->block_signals();
+    if (scheduler->get_thread(scheduler->get_running_thread_tid()).rt_period == 0) {
+        scheduler->unblock_signals();
+        return handleErrorLibrary((char  *) "The thread has no deadline");
+    }
+    scheduler->wait_next_period();
+    scheduler->unblock_signals();
+    return 0;
+}
+
+
+/**
+ * @brief Puts the thread with ID tid in the gang with ID gang, or takes it out of its gang if gang is 0.
+ *
+ * The members of a gang are scheduled together: whenever one is dispatched, its READY siblings are dispatched on
+ * other workers at the same time, and when the quantum of one expires, the others are preempted with it.
+ * A gang may have at most as many members as there are workers.
+ * If no thread with ID tid exists, if gang is negative, or if the gang is already full, it is considered an error.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_set_gang(int tid, int gang) {
+    if (gang < 0) {
+        return handleErrorLibrary((char  *) "Negative gang");
+    }
+    scheduler->block_signals();
+    if (!scheduler->check_thread(tid)) {
+        scheduler->unblock_signals();
+        return handleErrorLibrary((char  *) "The id is invalid");
+    }
+    if (gang != 0 && scheduler->get_thread(tid).gang != gang &&
+        scheduler->get_gang_size(gang) >= scheduler->get_worker_count()) {
+        scheduler->unblock_signals();
+        return handleErrorLibrary((char  *) "The gang has as many members as there are workers");
+    }
+    scheduler->set_thread_gang(tid, gang);
+    scheduler->unblock_signals();
+    return 0;
+}
+
+
+/**
+ * @brief Returns the ID of the gang of the thread with ID tid, 0 if it is in none.
+ *
+ * It is an error to call this function with a tid of a thread that does not exist.
+ *
+ * @return On success, return the gang ID. On failure, return -1.
+*/
+int uthread_get_gang(int tid) {
+    scheduler->block_signals();
+    if (!scheduler->check_thread(tid)) {
+        scheduler->unblock_signals();
+        return handleErrorLibrary((char  *) "The id is invalid");
+    }
+    int gang = scheduler->get_thread(tid).gang;
+    scheduler->unblock_signals();
+    return gang;
+}
+
+
+/**
+ * @brief Pins the kernel thread of the worker with ID worker to the CPU cpu.
+ *
+ * It is an error if no worker with ID worker exists, or if cpu is not a CPU the process may run on.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_pin_worker(int worker, int cpu) {
+    if (worker < 0 || (size_t) worker >= scheduler->get_worker_count()) {
+        return handleErrorLibrary((char  *) "no worker with ID worker exists");
+    }
+    if (cpu < 0 || cpu >= CPU_SETSIZE) {
+        return handleErrorLibrary((char  *) "The cpu is invalid");
+    }
+    scheduler->block_signals();
+    int result = scheduler->pin_worker(worker, cpu);
+    scheduler->unblock_signals();
+    return result;
+}
+
+
 /**
  * @brief Returns the thread ID of the calling thread.
  *
  * @return The ID of the calling thread.
 */
 int uthread_get_tid() {
-    return scheduler->get_running_thread_tid();
+    // the calling thread may move to another worker, so its worker is only looked up in the library
+    scheduler->block_signals();
+    int tid = scheduler->get_running_thread_tid();
+    scheduler->unblock_signals();
+    return tid;
+}
+
+
+/**
+ * @brief Returns the ID of the worker running the calling thread.
+ *
+ * Workers are numbered from 0, the kernel thread that called uthread_init, to the number of workers - 1.
+ *
+ * @return The ID of the calling thread's worker.
+*/
+int uthread_get_worker_id() {
+    scheduler->block_signals();
+    int worker = (int) scheduler->get_running_worker_id();
+    scheduler->unblock_signals();
+    return worker;
 }
 
 
@@ -203,3 +672,80 @@ int uthread_get_quantums(int tid){
 }
 
 
+/**
+ * @brief Returns the high-water mark of the stack memory committed for the thread with ID tid.
+ *
+ * Thread stacks are reserved at their full size but their pages are only committed once touched, so this is the
+ * memory the thread's stack actually uses. The main thread (tid == 0) runs on the process stack and always reports 0.
+ * If no thread with ID tid exists it is considered an error.
+ *
+ * @return On success, return the number of committed bytes. On failure, return -1.
+*/
+long uthread_get_stack_usage(int tid){
+    scheduler->block_signals();
+    if (!scheduler->check_thread(tid)) {
+        scheduler->unblock_signals();
+        return handleErrorLibrary((char  *) "no thread with ID tid exists");
+    }
+    long usage = (long) scheduler->get_thread(tid).get_stack_usage();
+    scheduler->unblock_signals();
+    return usage;
+}
+
+
+/**
+ * @brief Fills stats with the library's internal counters.
+ *
+ * It is an error to call this function with a null stats.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_get_stats(uthread_stats_t * stats){
+    if (stats == nullptr) {
+        return handleErrorLibrary((char  *) "Null stats");
+    }
+    scheduler->block_signals();
+    stats->stack_pool_hits = scheduler->get_stack_pool_hits();
+    stats->stack_pool_misses = scheduler->get_stack_pool_misses();
+    stats->stack_committed = scheduler->get_total_stack_usage();
+    stats->steals = scheduler->get_total_steals();
+    stats->migrations = scheduler->get_total_migrations();
+    stats->gang_coschedules = scheduler->get_gang_coschedules();
+    stats->demotions = scheduler->get_demotions();
+    stats->boosts = scheduler->get_boosts();
+    stats->deadline_misses = scheduler->get_deadline_misses();
+    scheduler->unblock_signals();
+    return 0;
+}
+
+
+/**
+ * @brief Fills stats with the counters of the worker with ID worker.
+ *
+ * Workers are numbered from 0, the kernel thread that called uthread_init, to the number of workers - 1.
+ * It is an error to call this function with a null stats or with no worker with ID worker.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_get_worker_stats(int worker, uthread_worker_stats_t * stats){
+    if (stats == nullptr) {
+        return handleErrorLibrary((char  *) "Null stats");
+    }
+    scheduler->block_signals();
+    if (worker < 0 || (size_t) worker >= scheduler->get_worker_count()) {
+        scheduler->unblock_signals();
+        return handleErrorLibrary((char  *) "no worker with ID worker exists");
+    }
+    const Worker & counted = scheduler->get_worker(worker);
+    stats->ready_threads = counted.ready_threads.size();
+    stats->steals = counted.steals;
+    stats->stolen = counted.stolen;
+    stats->cpu = counted.cpu;
+    stats->node = counted.node;
+    stats->parks = counted.parks.load(std::memory_order_relaxed);
+    stats->migrated_in = counted.migrated_in;
+    stats->migrated_out = counted.migrated_out;
+    stats->handoffs = counted.handoffs;
+    scheduler->unblock_signals();
+    return 0;
+}
@@ -8,11 +8,76 @@
 #define _UTHREADS_H
 
 
+#include <stddef.h>
+
 #define MAX_THREAD_NUM 100 /* maximal number of threads */
-#define STACK_SIZE 4096 /* stack size per thread (in bytes) */
+#define STACK_SIZE (1024 * 1024) /* stack size per thread (in bytes), only committed once touched */
+#define STACK_GUARD_SIZE 4096 /* inaccessible area below each thread stack (in bytes) */
+#define MAX_WORKER_NUM 64 /* maximal number of kernel threads running user-level threads */
+#define IDLE_SPIN_USECS 50 /* default time an idle worker spins before it parks (in micro-seconds) */
+#define BALANCE_INTERVAL 10 /* default number of quantums between two load balancing passes */
+#define BALANCE_MAX_MIGRATIONS 4 /* default maximal number of threads moved by one load balancing pass */
+#define PRIORITY_LEVELS 32 /* number of thread priorities, from 0 (runs last) to PRIORITY_LEVELS - 1 (runs first) */
+#define DEFAULT_PRIORITY 16 /* priority of the threads spawned by uthread_spawn and of the main thread */
+#define MLFQ_BOOST_INTERVAL 100 /* default number of quantums between two boosts of the MLFQ policy */
+
+#define UTHREAD_SCHED_PRIORITY 0 /* threads keep the priority they are given */
+#define UTHREAD_SCHED_MLFQ 1 /* threads that use up their quantum lose a priority level, and get it back on a boost */
+#define UTHREAD_SCHED_FAIR 2 /* the thread that used the least CPU time, weighted by its priority, runs first */
+#define UTHREAD_SCHED_EDF 3 /* threads with a deadline run earliest deadline first, ahead of those by priority */
 
 typedef void (*thread_entry_point)(void);
 
+/* Per-thread parameters for uthread_spawn_ex, set to their defaults by uthread_attr_init */
+typedef struct {
+    size_t stack_size; /* stack size (in bytes), rounded up to whole pages */
+    size_t guard_size; /* size of the guard area below the stack (in bytes), 0 for none. Every guard takes a
+                          memory mapping of its own, so very large numbers of threads need guard_size 0 */
+    unsigned long long worker_mask; /* workers the thread may run on, bit i for worker i */
+    int priority; /* the READY thread of highest priority runs first, in [0, PRIORITY_LEVELS - 1] */
+    int time_slice_usecs; /* length of the thread's quantums (in micro-seconds), 0 for the library's quantum */
+} uthread_attr_t;
+
+/* Library-wide parameters for uthread_init_ex, set to their defaults by uthread_config_init */
+typedef struct {
+    int max_threads; /* maximal number of concurrent threads, including the main thread */
+    int workers;     /* number of kernel threads running user-level threads in parallel, up to MAX_WORKER_NUM */
+    int place_workers; /* non-zero to pin the workers, when there are several, one per physical core first */
+    long idle_spin_usecs; /* time a worker with no thread to run spins before it parks (in micro-seconds) */
+    int balance_interval; /* quantums between two passes evening out the workers' READY queues, 0 for none */
+    int balance_max_migrations; /* maximal number of threads moved to another worker by one such pass */
+    int handoff; /* non-zero to run a thread resumed by uthread_resume right after the thread that resumed it */
+    int policy;  /* scheduling policy, one of the UTHREAD_SCHED_ values */
+    int boost_interval; /* quantums between two MLFQ boosts back to the threads' own priorities, 0 for none */
+} uthread_config_t;
+
+/* Counters describing the library's internal state, filled by uthread_get_stats */
+typedef struct {
+    unsigned long stack_pool_hits;   /* spawns that reused a recycled stack */
+    unsigned long stack_pool_misses; /* spawns that had to map a new stack */
+    unsigned long stack_committed;   /* bytes of thread stacks currently committed in memory */
+    unsigned long steals;            /* threads a worker took from the READY queue of another worker */
+    unsigned long migrations;        /* threads the load balancer moved to the READY queue of another worker */
+    unsigned long gang_coschedules;  /* gang members dispatched on another worker alongside a running sibling */
+    unsigned long demotions;         /* times the MLFQ policy lowered a thread that used up its quantum */
+    unsigned long boosts;            /* times the MLFQ policy raised all threads back to their own priorities */
+    unsigned long deadline_misses;   /* EDF jobs that ended after their deadline or ran out of budget */
+} uthread_stats_t;
+
+/* Counters describing one worker, filled by uthread_get_worker_stats */
+typedef struct {
+    unsigned long ready_threads; /* threads currently in the worker's READY queue */
+    unsigned long steals;        /* threads the worker took from the READY queues of other workers */
+    unsigned long stolen;        /* threads other workers took from the worker's READY queue */
+    int cpu;                     /* CPU the worker is pinned to, -1 if it is not pinned */
+    int node;                    /* NUMA node of that CPU, whose memory the stacks the worker spawns prefer, -1 if
+                                    the worker is not pinned */
+    unsigned long parks;         /* times the worker had no thread to run and parked its kernel thread */
+    unsigned long migrated_in;   /* threads the load balancer moved to the worker */
+    unsigned long migrated_out;  /* threads the load balancer moved away from the worker */
+    unsigned long handoffs;      /* threads run right after the thread on this worker that resumed them */
+} uthread_worker_stats_t;
+
 /* External interface */
 
 
@@ -30,13 +95,51 @@ typedef void (*thread_entry_point)(void);
 */
 int uthread_init(int quantum_usecs);
 
+/**
+ * @brief Sets config to the defaults used by uthread_init: at most MAX_THREAD_NUM concurrent threads, all run by
+ * the kernel thread that calls uthread_init.
+ *
+ * It is an error to call this function with a null config.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_config_init(uthread_config_t * config);
+
+
+/**
+ * @brief Initializes the thread library like uthread_init, with the library-wide parameters given in config.
+ *
+ * A null config is the same as the defaults set by uthread_config_init. The thread tables start small and grow in
+ * chunks as threads are spawned, so a large max_threads only costs memory once that many threads exist.
+ * With more than one worker, the calling kernel thread becomes worker 0 and workers - 1 more kernel threads are
+ * started, so up to workers threads are RUNNING at once. Each worker has a READY queue of its own, and a worker
+ * whose queue is empty steals threads from the others, nearest first. Unless place_workers is 0, the workers are
+ * pinned to CPUs read from /sys, one per physical core before any SMT sibling. A worker with no thread to run
+ * spins for idle_spin_usecs, then parks until a thread is queued for it. Every balance_interval quantums, up to
+ * balance_max_migrations READY threads are moved from the most loaded worker to the least loaded one. With handoff,
+ * a resumed thread skips its worker's queue and runs as soon as the thread that resumed it leaves the CPU.
+ * Under the UTHREAD_SCHED_MLFQ policy, a thread preempted when its quantum expires drops one priority level, while
+ * one that blocks, sleeps or yields first keeps its level, and every boost_interval quantums all threads are raised
+ * back to the priority they were given. Under the UTHREAD_SCHED_FAIR policy, priorities do not order the threads but
+ * weigh the CPU time they are charged, measured to the nanosecond, and the thread charged least runs next: each
+ * thread gets a share of its worker proportional to its weight, which grows by 25% per priority level. Under the
+ * UTHREAD_SCHED_EDF policy, threads given a deadline by uthread_set_deadline run earliest deadline first.
+ * It is an error to call this function with non-positive quantum_usecs, a non-positive max_threads, a number of
+ * workers outside [1, MAX_WORKER_NUM], a negative idle_spin_usecs, balance_interval, balance_max_migrations or
+ * boost_interval, or an unknown policy.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_init_ex(int quantum_usecs, const uthread_config_t * config);
+
+
 /**
  * @brief Creates a new thread, whose entry point is the function entry_point with the signature
  * void entry_point(void).
  *
  * The thread is added to the end of the READY threads list.
  * The uthread_spawn function should fail if it would cause the number of concurrent threads to exceed the
- * limit (MAX_THREAD_NUM).
+ * limit (MAX_THREAD_NUM, or the max_threads given to uthread_init_ex).
  * Each thread should be allocated with a stack of size STACK_SIZE bytes.
  * It is an error to call this function with a null entry_point.
  *
@@ -45,6 +148,29 @@ int uthread_init(int quantum_usecs);
 int uthread_spawn(thread_entry_point entry_point);
 
 
+/**
+ * @brief Sets attr to the defaults used by uthread_spawn: a STACK_SIZE stack above a STACK_GUARD_SIZE guard, any
+ * worker, DEFAULT_PRIORITY and the library's quantum.
+ *
+ * It is an error to call this function with a null attr.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_attr_init(uthread_attr_t * attr);
+
+
+/**
+ * @brief Creates a new thread like uthread_spawn, with the per-thread parameters given in attr.
+ *
+ * A null attr is the same as the defaults set by uthread_attr_init.
+ * It is an error to call this function with a null entry_point, with a zero stack_size, with a worker_mask that
+ * has no existing worker, with a priority outside [0, PRIORITY_LEVELS - 1] or with a negative time_slice_usecs.
+ *
+ * @return On success, return the ID of the created thread. On failure, return -1.
+*/
+int uthread_spawn_ex(thread_entry_point entry_point, const uthread_attr_t * attr);
+
+
 /**
  * @brief Terminates the thread with ID tid and deletes it from all relevant control structures.
  *
@@ -97,6 +223,150 @@ int uthread_resume(int tid);
 int uthread_sleep(int num_quantums);
 
 
+/**
+ * @brief Gives up the CPU: the RUNNING thread moves to the end of the READY queue and the next READY thread runs.
+ *
+ * The switch is made directly, without waiting for the timer signal, and counts as the start of a new quantum.
+ * The timer is re-armed, so the next thread runs for a whole time slice of its own.
+ * If the RUNNING thread is still the next to run once queued (no other thread of at least its priority is READY)
+ * the function returns immediately and no new quantum starts.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_yield();
+
+
+/**
+ * @brief Restricts the thread with ID tid to the workers whose bits are set in worker_mask (bit i for worker i).
+ *
+ * Bits of workers that do not exist are ignored. A READY thread queued on a worker it may no longer run on moves to
+ * the queue of one it may, and a RUNNING thread on such a worker is preempted and moves the same way.
+ * If no thread with ID tid exists, or if worker_mask has no existing worker, it is considered an error.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_set_affinity(int tid, unsigned long long worker_mask);
+
+
+/**
+ * @brief Stores in worker_mask the workers the thread with ID tid may run on (bit i for worker i).
+ *
+ * It is an error to call this function with a null worker_mask or if no thread with ID tid exists.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_get_affinity(int tid, unsigned long long * worker_mask);
+
+
+/**
+ * @brief Sets the priority of the thread with ID tid, in [0, PRIORITY_LEVELS - 1].
+ *
+ * A worker always runs its READY thread of highest priority first, round-robin among threads of equal priority.
+ * Under the MLFQ policy this is the thread's own priority, which it falls below as it uses up quantums.
+ * A worker running a thread of lower priority than a thread that becomes READY on it is preempted at once.
+ * Under the FAIR policy the priority is instead the weight of the thread's share of the CPU.
+ * If no thread with ID tid exists, or if priority is out of range, it is considered an error.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_set_priority(int tid, int priority);
+
+
+/**
+ * @brief Returns the priority of the thread with ID tid, as lowered by the MLFQ policy.
+ *
+ * It is an error to call this function with a tid of a thread that does not exist.
+ *
+ * @return On success, return the priority of the thread. On failure, return -1.
+*/
+int uthread_get_priority(int tid);
+
+
+/**
+ * @brief Sets the length of the quantums of the thread with ID tid, or gives it the library's quantum again if
+ * time_slice_usecs is 0.
+ *
+ * Long slices suit batch threads, which are then switched out less often, and short slices suit threads that must
+ * leave the CPU to others quickly. The new length applies from the next time the thread is dispatched.
+ * If no thread with ID tid exists, or if time_slice_usecs is negative, it is considered an error.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_set_time_slice(int tid, int time_slice_usecs);
+
+
+/**
+ * @brief Returns the length of the quantums of the thread with ID tid (in micro-seconds).
+ *
+ * It is an error to call this function with a tid of a thread that does not exist.
+ *
+ * @return On success, return the length of the thread's quantums. On failure, return -1.
+*/
+int uthread_get_time_slice(int tid);
+
+
+/**
+ * @brief Gives the thread with ID tid a deadline under the UTHREAD_SCHED_EDF policy: a job is released every
+ * period_usecs, which must be done within budget_usecs of CPU time by deadline_usecs after its release.
+ *
+ * A deadline_usecs of 0 is the same as period_usecs, and a period_usecs of 0 takes the thread's deadline away.
+ * The first job is released at once, and each later one once the thread called uthread_wait_period. A worker always
+ * runs its READY thread of earliest deadline first, ahead of the threads without one, which run by priority.
+ * A thread that uses up its budget waits for its next job, and the job counts as a deadline miss.
+ * The thread is only admitted if, with it, the sum U of budget over deadline of all threads with deadlines, the
+ * largest of which is u_max, is at most M - (M - 1) * u_max on M workers, so that their deadlines can be met.
+ * It is an error if the policy is not UTHREAD_SCHED_EDF, if no thread with ID tid exists, if budget_usecs is not
+ * positive or exceeds deadline_usecs, if deadline_usecs exceeds period_usecs, if a value is negative, or if the
+ * thread is not admitted.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_set_deadline(int tid, int period_usecs, int budget_usecs, int deadline_usecs);
+
+
+/**
+ * @brief Ends the current job of the calling thread, which has a deadline, and waits for its next job's release.
+ *
+ * It is an error to call this function from a thread without a deadline.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_wait_period();
+
+
+/**
+ * @brief Puts the thread with ID tid in the gang with ID gang, or takes it out of its gang if gang is 0.
+ *
+ * The members of a gang are scheduled together: whenever one is dispatched, its READY siblings are dispatched on
+ * other workers at the same time, and when the quantum of one expires, the others are preempted with it.
+ * A gang may have at most as many members as there are workers.
+ * If no thread with ID tid exists, if gang is negative, or if the gang is already full, it is considered an error.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_set_gang(int tid, int gang);
+
+
+/**
+ * @brief Returns the ID of the gang of the thread with ID tid, 0 if it is in none.
+ *
+ * It is an error to call this function with a tid of a thread that does not exist.
+ *
+ * @return On success, return the gang ID. On failure, return -1.
+*/
+int uthread_get_gang(int tid);
+
+
+/**
+ * @brief Pins the kernel thread of the worker with ID worker to the CPU cpu.
+ *
+ * It is an error if no worker with ID worker exists, or if cpu is not a CPU the process may run on.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_pin_worker(int worker, int cpu);
+
+
 /**
  * @brief Returns the thread ID of the calling thread.
  *
@@ -105,6 +375,16 @@ int uthread_sleep(int num_quantums);
 int uthread_get_tid();
 
 
+/**
+ * @brief Returns the ID of the worker running the calling thread.
+ *
+ * Workers are numbered from 0, the kernel thread that called uthread_init, to the number of workers - 1.
+ *
+ * @return The ID of the calling thread's worker.
+*/
+int uthread_get_worker_id();
+
+
 /**
  * @brief Returns the total number of quantums since the library was initialized, including the current quantum.
  *
@@ -128,4 +408,37 @@ int uthread_get_total_quantums();
 int uthread_get_quantums(int tid);
 
 
+/**
+ * @brief Returns the high-water mark of the stack memory committed for the thread with ID tid.
+ *
+ * Thread stacks are reserved at their full size but their pages are only committed once touched, so this is the
+ * memory the thread's stack actually uses. The main thread (tid == 0) runs on the process stack and always reports 0.
+ * If no thread with ID tid exists it is considered an error.
+ *
+ * @return On success, return the number of committed bytes. On failure, return -1.
+*/
+long uthread_get_stack_usage(int tid);
+
+
+/**
+ * @brief Fills stats with the library's internal counters.
+ *
+ * It is an error to call this function with a null stats.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_get_stats(uthread_stats_t * stats);
+
+
+/**
+ * @brief Fills stats with the counters of the worker with ID worker.
+ *
+ * Workers are numbered from 0, the kernel thread that called uthread_init, to the number of workers - 1.
+ * It is an error to call this function with a null stats or with no worker with ID worker.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_get_worker_stats(int worker, uthread_worker_stats_t * stats);
+
+
 #endif